@@ -0,0 +1,26 @@
+#!/bin/sh
+# Reports the code placed in SRAM (.ramtext, see src/ramfunc.h)
+# usage: ramfunc_report.sh <nm> <elf>
+
+set -e
+set -u
+
+NM=$1
+ELF=$2
+
+addr() {
+    $NM "$ELF" | awk -v s="$1" '$3 == s { print "0x" $1 }'
+}
+
+START=$(addr __ramtext_start__)
+END=$(addr __ramtext_end__)
+HEAP_BASE=$(addr __heap_base__)
+HEAP_END=$(addr __heap_end__)
+
+echo "Code in SRAM: $((END - START)) bytes, also stored in flash"
+$NM -S --size-sort "$ELF" | while read -r a size type name; do
+    if [ $((0x$a)) -ge $((START)) ] && [ $((0x$a)) -lt $((END)) ]; then
+        printf "%8d  %s\n" $((0x$size)) "$name"
+    fi
+done
+echo "SRAM left for the heap (CAN receive queue): $((HEAP_END - HEAP_BASE)) bytes"
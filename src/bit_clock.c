@@ -0,0 +1,63 @@
+#include "bit_clock.h"
+#include "ramfunc.h"
+
+// bit times since the us clock started, modulo 2^16
+static RAMFUNC uint16_t bit_clock_ticks(const struct bit_clock_s* c, uint64_t t)
+{
+    return (t / 1000000) * c->bitrate + (t % 1000000) * c->bitrate / 1000000;
+}
+
+static RAMFUNC bool bit_clock_window_over(const struct bit_clock_s* c, uint64_t now)
+{
+    return now - c->window >= BIT_CLOCK_WINDOW_US;
+}
+
+void bit_clock_init(struct bit_clock_s* c, uint32_t bitrate)
+{
+    c->bitrate = bitrate;
+    c->phase = 0;
+    c->best = 0;
+    c->previous = 0;
+    c->current = false;
+    c->valid = false;
+    c->window = 0;
+}
+
+RAMFUNC bool bit_clock_improves(const struct bit_clock_s* c, uint16_t time, unsigned int bits, uint64_t now)
+{
+    uint16_t bound = time + bits - bit_clock_ticks(c, now);
+    return !c->current || bit_clock_window_over(c, now) || (int16_t)(bound - c->best) > 0;
+}
+
+RAMFUNC void bit_clock_sync(struct bit_clock_s* c, uint16_t time, unsigned int bits, uint64_t now)
+{
+    if (!bit_clock_improves(c, time, bits, now)) {
+        return;
+    }
+    if (bit_clock_window_over(c, now)) {
+        if (c->current) {
+            c->previous = c->best;
+            c->current = false;
+        }
+        c->window = now;
+    }
+    uint16_t bound = time + bits - bit_clock_ticks(c, now);
+    if (!c->current || (int16_t)(bound - c->best) > 0) {
+        c->best = bound;
+        c->current = true;
+    }
+    if (!c->valid) {
+        c->previous = bound;
+        c->valid = true;
+    }
+    c->phase = (int16_t)(c->previous - c->best) > 0 ? c->previous : c->best;
+}
+
+RAMFUNC uint64_t bit_clock_sof(const struct bit_clock_s* c, uint16_t time, uint64_t now)
+{
+    if (!c->valid) {
+        return now;
+    }
+    uint16_t age = bit_clock_ticks(c, now) + c->phase - time;
+    return now - (uint64_t)age * 1000000 / c->bitrate;
+}
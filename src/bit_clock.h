@@ -0,0 +1,55 @@
+#ifndef BIT_CLOCK_H
+#define BIT_CLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CAN bit clock
+ * In time triggered mode the controller latches its free running 16 bit
+ * counter, incremented every bit time, at the start of frame of every
+ * received and transmitted frame. The phase of the counter to the us clock
+ * is learned from received frames: a frame can't be read before it is
+ * complete, so the phase is at least TIME + bits - now in bit times. The
+ * counter runs on the bit timing of the bus, which drifts against the us
+ * clock by the difference of the nodes' oscillators (100 ppm is 1 ms in
+ * 10 s). The estimate is the largest bound of the current and the previous
+ * window of BIT_CLOCK_WINDOW_US, so it carries the shortest read latency of
+ * the last two windows and follows the drift in both directions. Without
+ * frames the last estimate is kept.
+ */
+#define BIT_CLOCK_WINDOW_US 10000
+
+struct bit_clock_s {
+    uint32_t bitrate;
+    uint16_t phase; // estimate
+    uint16_t best; // largest bound of the current window
+    uint16_t previous; // largest bound of the previous window
+    bool current; // best holds a bound
+    bool valid; // at least one frame seen
+    uint64_t window; // start of the current window [us]
+};
+
+void bit_clock_init(struct bit_clock_s* c, uint32_t bitrate);
+
+/* frame latched at time, complete after bits, read at now [us] */
+void bit_clock_sync(struct bit_clock_s* c, uint16_t time, unsigned int bits, uint64_t now);
+
+/* true if bit_clock_sync() with up to bits would change the estimate, so
+ * the exact frame length is only computed when it matters */
+bool bit_clock_improves(const struct bit_clock_s* c, uint16_t time, unsigned int bits, uint64_t now);
+
+/* Start of frame [us] of a frame latched at time and read at now
+ * the frame must be read within 65536 bit times, returns now until the
+ * clock is synchronized.
+ */
+uint64_t bit_clock_sof(const struct bit_clock_s* c, uint16_t time, uint64_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BIT_CLOCK_H */
@@ -4,11 +4,22 @@
 #include <string.h>
 #include <timestamp/timestamp.h>
 #include "can_driver.h"
+#include "bit_clock.h"
+#include "frame_bits.h"
+#include "ramfunc.h"
+#include "capture.h"
+#include "cpu_load.h"
+#include "latency.h"
+#include "trace.h"
+#include "tx_mailbox.h"
 
-#define CAN_RX_BUFFER_SIZE 100
+/* The receive queue takes the RAM the linker leaves over between the end of
+ * the static data and the end of ram0 (the ChibiOS core memory), minus a
+ * reserve for the core allocator. */
+#define CAN_RX_RAM_RESERVE 256
 
-// size+2 for the 2 threads handling CAN frames from can_rx_pool
-#define CAN_RX_POOL_SIZE CAN_RX_BUFFER_SIZE + 2
+// 2 more records than queue entries, for the 2 threads handling them
+#define CAN_RX_POOL_EXTRA 2
 
 #define CAN_BTR_BRP_MASK 0x000003FF
 #define CAN_BTR_TS1_MASK 0x000F0000
@@ -31,11 +42,36 @@ static bool can_btr_from_bitrate(uint32_t bitrate, uint32_t* btr_value);
 static void wait_on_request(void);
 static void can_rx_queue_post(struct can_frame_s* fp);
 static void can_rx_queue_flush(void);
+static void can_event_post(uint8_t type, const uint8_t* data, uint8_t length, ltimestamp_t now);
+static void can_monitor_update(const struct can_frame_s* fp, ltimestamp_t now);
+static void can_monitor_poll(ltimestamp_t now);
+static void can_capture_update(const struct can_frame_s* fp, ltimestamp_t now);
+static void can_error_update(eventflags_t flags, ltimestamp_t now);
+static void can_bench_update(const struct can_frame_s* fp);
+static void can_status_poll(ltimestamp_t now);
+static void can_tx_credit_update(ltimestamp_t now);
+
+static thread_t* can_notify_thread = NULL;
+static eventmask_t can_notify_rx;
+static eventmask_t can_notify_tx;
+
+static event_listener_t can_error_listener;
+static event_listener_t can_rx_listener;
+static event_listener_t can_tx_listener;
+
+static struct can_stats_s can_stats;
+static uint32_t can_status_period = 0; // [ms], 0 when disabled
+static unsigned int can_rx_pool_used = 0;
 
 bool can_is_running = false;
+static uint32_t can_bitrate = CAN_DEFAULT_BITRATE;
+
+// serializes transmissions from several threads with can_close
+MUTEX_DECL(can_tx_lock);
 
 static CANConfig can_config = {
     .mcr = (1 << 6) // Automatic bus-off management enabled
+        | CAN_MCR_TTCM // Time stamps latched at the start of frame
         | (1 << 2), // Message are prioritized by order of arrival
     .btr = CAN_BTR_SILM // Silent mode
         | CAN_BTR_SJW_0 // 2tq resynchronization jump width
@@ -70,11 +106,62 @@ static void wait_on_request(void)
 
 memory_pool_t can_rx_pool;
 mailbox_t can_rx_queue;
-msg_t rx_mbox_buf[CAN_RX_BUFFER_SIZE];
-struct can_frame_s rx_pool_buf[CAN_RX_POOL_SIZE];
+static unsigned int can_rx_queue_size;
+
+static RAMFUNC struct can_frame_s* can_frame_alloc(void)
+{
+    struct can_frame_s* f = (struct can_frame_s*)chPoolAlloc(&can_rx_pool);
+    if (f == NULL) {
+        return NULL;
+    }
+    chSysLock();
+    can_rx_pool_used++;
+    if (can_rx_pool_used > can_stats.pool_high_water) {
+        can_stats.pool_high_water = can_rx_pool_used;
+    }
+    chSysUnlock();
+    return f;
+}
+
+static RAMFUNC void can_frame_free(struct can_frame_s* f)
+{
+    chSysLock();
+    can_rx_pool_used--;
+    chSysUnlock();
+    chPoolFree(&can_rx_pool, f);
+}
+
+RAMFUNC uint32_t can_timestamp(ltimestamp_t t)
+{
+    return t % CAN_TIMESTAMP_WRAP;
+}
+
+// records are fetched long before their timestamp wraps
+uint32_t can_frame_time(const struct can_frame_s* f)
+{
+    ltimestamp_t now = ltimestamp_get();
+    uint32_t age = (can_timestamp(now) + CAN_TIMESTAMP_WRAP - f->timestamp) % CAN_TIMESTAMP_WRAP;
+    return now - age;
+}
 
-bool can_send(uint32_t id, bool extended, bool remote, uint8_t* data, size_t length)
+/* The mailbox of every request is recorded with its completion function,
+ * the receive thread accounts the completions, see tx_mailbox.h. */
+static struct tx_mailbox_s can_tx_mailboxes;
+// signaled when a mailbox was accounted
+BSEMAPHORE_DECL(can_tx_accounted, true);
+
+#if TX_MAILBOX_COUNT != CAN_TX_MAILBOXES
+#error "transmit mailbox count"
+#endif
+
+static RAMFUNC bool can_transmit(uint32_t id, bool extended, bool remote, uint8_t* data, size_t length,
+                                 tx_done_t done, uint32_t tag)
 {
+    chMtxLock(&can_tx_lock);
+    if (!can_is_running) {
+        chMtxUnlock(&can_tx_lock);
+        return false;
+    }
     led_set(CAN1_STATUS_LED);
     CANTxFrame txf;
     if (extended) {
@@ -91,31 +178,152 @@ bool can_send(uint32_t id, bool extended, bool remote, uint8_t* data, size_t len
         txf.RTR = 0;
         memcpy(&txf.data8[0], data, length);
     }
-    msg_t m = canTransmit(&CAND1, CAN_ANY_MAILBOX, &txf, MS2ST(100));
+    /* The request goes to an empty mailbox whose last completion was
+     * accounted, the transmit lock keeps it empty. */
+    unsigned int mailbox;
+    msg_t m = MSG_OK;
+    while ((mailbox = tx_mailbox_pick(&can_tx_mailboxes, (CAND1.can->TSR & CAN_TSR_TME) / CAN_TSR_TME0)) == 0) {
+        m = chBSemWaitTimeout(&can_tx_accounted, MS2ST(100));
+        if (m != MSG_OK) {
+            break;
+        }
+    }
+    if (m == MSG_OK) {
+        tx_mailbox_load(&can_tx_mailboxes, mailbox, done, tag);
+        m = canTransmit(&CAND1, mailbox, &txf, TIME_IMMEDIATE);
+        if (m != MSG_OK) {
+            tx_mailbox_cancel(&can_tx_mailboxes, mailbox);
+        }
+    }
+    if (m == MSG_OK) {
+        can_stats.tx_frames++;
+        trace_event(TRACE_CAN_TX, id);
+    } else {
+        trace_event(TRACE_CAN_TX_FAIL, id);
+    }
+    chMtxUnlock(&can_tx_lock);
     if (m != MSG_OK) {
         return false;
     }
     return true;
 }
 
+RAMFUNC bool can_send(uint32_t id, bool extended, bool remote, uint8_t* data, size_t length)
+{
+    return can_transmit(id, extended, remote, data, length, NULL, 0);
+}
+
+RAMFUNC bool can_send_notify(uint32_t id, bool extended, bool remote, uint8_t* data, size_t length,
+                             tx_done_t done, uint32_t tag)
+{
+    return can_transmit(id, extended, remote, data, length, done, tag);
+}
+
+static bool can_tx_credit_enabled = false;
+static bool can_tx_credit_changed = false;
+static uint16_t can_tx_credit_granted;
+
+// a frame of the host is done, it grants a credit
+static void can_tx_host_done(uint32_t start, ltimestamp_t sof, bool ok)
+{
+    (void)sof;
+    (void)ok;
+    latency_add(LATENCY_TX_DONE, start);
+    chSysLock();
+    can_tx_credit_granted++;
+    if (can_tx_credit_enabled) {
+        can_tx_credit_changed = true;
+    }
+    chSysUnlock();
+}
+
+RAMFUNC bool can_send_timed(uint32_t id, bool extended, bool remote, uint8_t* data, size_t length, uint32_t start)
+{
+    return can_transmit(id, extended, remote, data, length, can_tx_host_done, start);
+}
+
+/* Receive and transmit times are the start of frame, latched by the
+ * controller in bit times and converted to the us clock, see bit_clock.h. */
+static struct bit_clock_s can_bit_clock;
+
+/* A received frame is valid at the next to last bit of its end of frame.
+ * The exact length with stuff bits keeps them out of the phase, it is only
+ * computed when the frame can improve it with the most stuff bits. */
+static RAMFUNC void can_rx_sync(const struct can_frame_s* fp, uint16_t time, ltimestamp_t read)
+{
+    if (bit_clock_improves(&can_bit_clock, time, frame_bits_max(fp) - 1, read)) {
+        bit_clock_sync(&can_bit_clock, time, frame_bits(fp) - 1, read);
+    }
+}
+
+/* Accounts the done mailboxes, their start of frame times stay latched
+ * until they are loaded again. Returns true if one was accounted. */
+static bool can_tx_complete(eventflags_t done, ltimestamp_t now)
+{
+    ltimestamp_t sof[CAN_TX_MAILBOXES];
+    ltimestamp_t last = now;
+    unsigned int i;
+    for (i = 0; i < CAN_TX_MAILBOXES; i++) {
+        uint16_t time = CAND1.can->sTxMailBox[i].TDTR >> 16;
+        sof[i] = bit_clock_sof(&can_bit_clock, time, now);
+    }
+    uint32_t accounted = tx_mailbox_complete(&can_tx_mailboxes, done, sof);
+    if (accounted == 0) {
+        can_tx_credit_update(now);
+        return false;
+    }
+    bool found = false;
+    for (i = 0; i < CAN_TX_MAILBOXES; i++) {
+        if ((accounted & (1 << i)) && (!found || sof[i] > last)) {
+            last = sof[i];
+            found = true;
+        }
+    }
+    chBSemSignal(&can_tx_accounted);
+    can_tx_credit_update(last);
+    return true;
+}
+
 static THD_WORKING_AREA(can_rx_thread_wa, 256);
-static THD_FUNCTION(can_rx_thread, arg)
+static RAMFUNC THD_FUNCTION(can_rx_thread, arg)
 {
     (void)arg;
     chRegSetThreadName("CAN rx");
+    chEvtRegisterMaskWithFlags(&CAND1.error_event, &can_error_listener, EVENT_MASK(0),
+                               CAN_LIMIT_WARNING | CAN_LIMIT_ERROR | CAN_BUS_OFF_ERROR
+                                   | CAN_FRAMING_ERROR | CAN_OVERFLOW_ERROR);
+    chEvtRegisterMask(&CAND1.rxfull_event, &can_rx_listener, EVENT_MASK(1));
+    // the lower half of the flags marks the done mailboxes, the upper half those done with an error
+    chEvtRegisterMaskWithFlags(&CAND1.txempty_event, &can_tx_listener, EVENT_MASK(2), 0xffffffff);
     while (1) {
         wait_on_request();
         CANRxFrame rxf;
-        msg_t m = canReceive(&CAND1, CAN_ANY_MAILBOX, &rxf, MS2ST(10));
+        msg_t m = canReceive(&CAND1, CAN_ANY_MAILBOX, &rxf, TIME_IMMEDIATE);
+        if (m != MSG_OK) {
+            // woken by a received frame, a transmit completion or an error
+            chEvtWaitAnyTimeout(ALL_EVENTS, MS2ST(10));
+        }
+        ltimestamp_t now = ltimestamp_get();
+        eventflags_t errors = chEvtGetAndClearFlags(&can_error_listener);
+        if (errors) {
+            can_error_update(errors, now);
+        }
+        eventflags_t done = chEvtGetAndClearFlags(&can_tx_listener);
+        if (can_tx_complete(done, now) && can_notify_thread != NULL) {
+            chEvtSignal(can_notify_thread, can_notify_tx);
+        }
+        can_monitor_poll(now);
+        can_status_poll(now);
         if (m != MSG_OK) {
             continue;
         }
         led_set(CAN1_STATUS_LED);
-        struct can_frame_s* fp = (struct can_frame_s*)chPoolAlloc(&can_rx_pool);
+        can_stats.rx_frames++;
+        trace_event(TRACE_CAN_RX, rxf.IDE ? rxf.EID : rxf.SID);
+        struct can_frame_s* fp = can_frame_alloc();
         if (fp == NULL) {
             chSysHalt("CAN driver out of memory");
         }
-        fp->timestamp = timestamp_get() / 1000;
         if (rxf.IDE) {
             fp->id = rxf.EID;
             fp->extended = 1;
@@ -128,18 +336,286 @@ static THD_FUNCTION(can_rx_thread, arg)
         } else {
             fp->remote = 0;
         }
+        fp->event = 0;
         fp->length = rxf.DLC;
         memcpy(&fp->data[0], &rxf.data8[0], rxf.DLC);
+        can_rx_sync(fp, rxf.TIME, now);
+        ltimestamp_t sof = bit_clock_sof(&can_bit_clock, rxf.TIME, now);
+        fp->timestamp = can_timestamp(sof);
+        can_monitor_update(fp, sof);
+        can_capture_update(fp, sof);
         can_rx_queue_post(fp);
     }
 }
 
-static void can_rx_queue_post(struct can_frame_s* fp)
+void can_tx_credit_enable(bool enable)
 {
-    msg_t m = chMBPost(&can_rx_queue, (msg_t)fp, TIME_IMMEDIATE);
-    if (m != MSG_OK) {
-        chPoolFree(&can_rx_pool, fp);
-        can_rx_queue_flush();
+    chSysLock();
+    can_tx_credit_enabled = enable;
+    can_tx_credit_granted = CAN_TX_MAILBOXES;
+    can_tx_credit_changed = enable;
+    chSysUnlock();
+}
+
+// reports the credits granted by the completions accounted so far
+static void can_tx_credit_update(ltimestamp_t now)
+{
+    chSysLock();
+    bool report = can_tx_credit_enabled && can_tx_credit_changed;
+    can_tx_credit_changed = false;
+    uint16_t granted = can_tx_credit_granted;
+    chSysUnlock();
+    if (report) {
+        uint8_t data[2] = {granted >> 8, granted};
+        can_event_post(CAN_EVENT_TX_CREDIT, data, sizeof(data), now);
+    }
+}
+
+static void can_event_post(uint8_t type, const uint8_t* data, uint8_t length, ltimestamp_t now)
+{
+    struct can_frame_s* fp = can_frame_alloc();
+    if (fp == NULL) {
+        return;
+    }
+    fp->timestamp = can_timestamp(now);
+    fp->id = type;
+    fp->extended = 0;
+    fp->remote = 0;
+    fp->event = 1;
+    fp->length = length;
+    memcpy(&fp->data[0], data, length);
+    can_rx_queue_post(fp);
+}
+
+static struct period_monitor_s can_monitor;
+MUTEX_DECL(can_monitor_lock);
+
+static void can_monitor_event(uint32_t id, bool extended, uint32_t elapsed, ltimestamp_t now)
+{
+    if (extended) {
+        id |= (1UL << 31);
+    }
+    uint8_t data[8] = {id >> 24, id >> 16, id >> 8, id,
+                       elapsed >> 24, elapsed >> 16, elapsed >> 8, elapsed};
+    can_event_post(CAN_EVENT_DEADLINE_MISS, data, sizeof(data), now);
+}
+
+static void can_monitor_update(const struct can_frame_s* fp, ltimestamp_t now)
+{
+    uint32_t elapsed;
+    chMtxLock(&can_monitor_lock);
+    bool late = period_monitor_update(&can_monitor, fp->id, fp->extended, now, &elapsed) != NULL;
+    chMtxUnlock(&can_monitor_lock);
+    if (late) {
+        can_monitor_event(fp->id, fp->extended, elapsed, now);
+    }
+}
+
+// reports IDs which stopped arriving, runs even when no frames are received
+static void can_monitor_poll(ltimestamp_t now)
+{
+    while (1) {
+        uint32_t elapsed;
+        chMtxLock(&can_monitor_lock);
+        struct period_monitor_entry_s* e = period_monitor_check(&can_monitor, now, &elapsed);
+        uint32_t id = 0;
+        bool extended = false;
+        if (e != NULL) {
+            id = e->id;
+            extended = e->extended;
+        }
+        chMtxUnlock(&can_monitor_lock);
+        if (e == NULL) {
+            break;
+        }
+        can_monitor_event(id, extended, elapsed, now);
+    }
+}
+
+bool can_monitor_watch(uint32_t id, bool extended, uint32_t period)
+{
+    chMtxLock(&can_monitor_lock);
+    bool ok = period_monitor_watch(&can_monitor, id, extended, period);
+    chMtxUnlock(&can_monitor_lock);
+    return ok;
+}
+
+void can_monitor_clear(void)
+{
+    chMtxLock(&can_monitor_lock);
+    period_monitor_init(&can_monitor);
+    chMtxUnlock(&can_monitor_lock);
+}
+
+void can_monitor_reset(void)
+{
+    chMtxLock(&can_monitor_lock);
+    period_monitor_reset(&can_monitor);
+    chMtxUnlock(&can_monitor_lock);
+}
+
+bool can_monitor_get(unsigned int i, struct period_monitor_entry_s* e)
+{
+    if (i >= PERIOD_MONITOR_SIZE) {
+        return false;
+    }
+    chMtxLock(&can_monitor_lock);
+    *e = can_monitor.entries[i];
+    chMtxUnlock(&can_monitor_lock);
+    return e->active;
+}
+
+static struct capture_s can_capture;
+MUTEX_DECL(can_capture_lock);
+
+static void can_capture_update(const struct can_frame_s* fp, ltimestamp_t now)
+{
+    chMtxLock(&can_capture_lock);
+    bool done = capture_frame(&can_capture, fp);
+    uint16_t count = can_capture.count;
+    chMtxUnlock(&can_capture_lock);
+    if (done) {
+        uint8_t data[2] = {count >> 8, count};
+        can_event_post(CAN_EVENT_CAPTURE_DONE, data, sizeof(data), now);
+    }
+}
+
+// error records are only kept in captures, they are not sent to the host
+static void can_error_update(eventflags_t flags, ltimestamp_t now)
+{
+    struct can_frame_s f;
+    uint32_t esr = CAND1.can->ESR;
+    uint8_t errors = 0;
+    if (flags & CAN_LIMIT_WARNING) {
+        errors |= CAN_ERROR_WARNING;
+    }
+    if (flags & CAN_LIMIT_ERROR) {
+        errors |= CAN_ERROR_PASSIVE;
+    }
+    if (flags & CAN_BUS_OFF_ERROR) {
+        errors |= CAN_ERROR_BUS_OFF;
+    }
+    if (flags & CAN_FRAMING_ERROR) {
+        errors |= CAN_ERROR_FRAME;
+        can_stats.bus_errors++;
+    }
+    if (flags & CAN_OVERFLOW_ERROR) {
+        errors |= CAN_ERROR_OVERFLOW;
+        can_stats.fifo_overruns++;
+    }
+    f.timestamp = can_timestamp(now);
+    f.id = CAN_EVENT_BUS_ERROR;
+    f.extended = 0;
+    f.remote = 0;
+    f.event = 1;
+    f.length = 3;
+    f.data[0] = errors;
+    f.data[1] = (esr & CAN_ESR_TEC) >> 16;
+    f.data[2] = (esr & CAN_ESR_REC) >> 24;
+    can_capture_update(&f, now);
+}
+
+bool can_capture_arm(const struct capture_trigger_s* t, unsigned int pre, unsigned int post)
+{
+    chMtxLock(&can_capture_lock);
+    bool ok = capture_arm(&can_capture, t, pre, post);
+    chMtxUnlock(&can_capture_lock);
+    return ok;
+}
+
+void can_capture_freeze(void)
+{
+    chMtxLock(&can_capture_lock);
+    capture_freeze(&can_capture);
+    chMtxUnlock(&can_capture_lock);
+}
+
+int can_capture_state(unsigned int* count)
+{
+    chMtxLock(&can_capture_lock);
+    int state = can_capture.state;
+    *count = can_capture.count;
+    chMtxUnlock(&can_capture_lock);
+    return state;
+}
+
+bool can_capture_get(unsigned int i, struct can_frame_s* f)
+{
+    chMtxLock(&can_capture_lock);
+    const struct can_frame_s* fp = capture_get(&can_capture, i);
+    if (fp != NULL) {
+        *f = *fp;
+    }
+    chMtxUnlock(&can_capture_lock);
+    return fp != NULL;
+}
+
+static void can_rx_notify(void)
+{
+    if (can_notify_thread != NULL) {
+        chEvtSignal(can_notify_thread, can_notify_rx);
+    }
+}
+
+void can_notify(uint32_t rx_events, uint32_t tx_events)
+{
+    can_notify_rx = rx_events;
+    can_notify_tx = tx_events;
+    can_notify_thread = chThdGetSelfX();
+}
+
+bool can_tx_ready(void)
+{
+    return tx_mailbox_pick(&can_tx_mailboxes, (CAND1.can->TSR & CAN_TSR_TME) / CAN_TSR_TME0) != 0;
+}
+
+static uint32_t can_rx_dropped = 0;
+static unsigned int can_rx_high_water = 0;
+
+/* When the queue is full the new frame is dropped so that the backlog is
+ * kept, the number of dropped frames is reported in-band at the position of
+ * the gap once there is room again. */
+static RAMFUNC void can_rx_queue_post(struct can_frame_s* fp)
+{
+    if (can_rx_dropped > 0) {
+        struct can_frame_s* ep = can_frame_alloc();
+        if (ep != NULL) {
+            ep->timestamp = fp->timestamp;
+            ep->id = CAN_EVENT_RX_OVERFLOW;
+            ep->extended = 0;
+            ep->remote = 0;
+            ep->event = 1;
+            ep->length = 4;
+            ep->data[0] = can_rx_dropped >> 24;
+            ep->data[1] = can_rx_dropped >> 16;
+            ep->data[2] = can_rx_dropped >> 8;
+            ep->data[3] = can_rx_dropped;
+            if (chMBPost(&can_rx_queue, (msg_t)ep, TIME_IMMEDIATE) == MSG_OK) {
+                can_rx_dropped = 0;
+                can_rx_notify();
+            } else {
+                can_frame_free(ep);
+            }
+        }
+    }
+    if (can_rx_dropped > 0 || chMBPost(&can_rx_queue, (msg_t)fp, TIME_IMMEDIATE) != MSG_OK) {
+        can_frame_free(fp);
+        can_rx_dropped++;
+        can_stats.rx_dropped++;
+        trace_event(TRACE_RX_DROP, can_rx_dropped);
+        return;
+    }
+    latency_add(LATENCY_RX_POST, can_frame_time(fp));
+    can_rx_notify();
+    chSysLock();
+    unsigned int used = chMBGetUsedCountI(&can_rx_queue);
+    chSysUnlock();
+    trace_event(TRACE_RX_POST, used);
+    if (used > can_rx_high_water) {
+        can_rx_high_water = used;
+    }
+    if (used > can_stats.queue_high_water) {
+        can_stats.queue_high_water = used;
     }
 }
 
@@ -149,23 +625,26 @@ static void can_rx_queue_flush(void)
     while (1) {
         msg_t m = chMBFetch(&can_rx_queue, (msg_t*)&fp, TIME_IMMEDIATE);
         if (m == MSG_OK) {
-            chPoolFree(&can_rx_pool, fp);
+            can_frame_free(fp);
         } else {
             break;
         }
     }
 }
 
-void can_frame_delete(struct can_frame_s* f)
+RAMFUNC void can_frame_delete(struct can_frame_s* f)
 {
-    chPoolFree(&can_rx_pool, f);
+    can_frame_free(f);
 }
 
-struct can_frame_s* can_receive(void)
+RAMFUNC struct can_frame_s* can_receive(void)
 {
     struct can_frame_s* fp;
-    msg_t m = chMBFetch(&can_rx_queue, (msg_t*)&fp, MS2ST(100));
+    msg_t m = chMBFetch(&can_rx_queue, (msg_t*)&fp, TIME_IMMEDIATE);
     if (m == MSG_OK) {
+        trace_event(TRACE_RX_FETCH, 0);
+        latency_add(LATENCY_RX_FETCH, can_frame_time(fp));
+        can_bench_update(fp);
         return fp;
     }
     return NULL;
@@ -180,6 +659,7 @@ bool can_set_bitrate(uint32_t bitrate)
     uint32_t btr;
     if (can_btr_from_bitrate(bitrate, &btr)) {
         can_config.btr = (can_config.btr & ~CAN_BTR_TIMING_MASK) | btr;
+        can_bitrate = bitrate;
         return true;
     } else {
         return false;
@@ -205,10 +685,19 @@ bool can_open(int mode)
             can_config.btr |= CAN_BTR_SILM;
             can_set_silent_mode(true);
             break;
+        case CAN_MODE_SILENT_LOOPBACK:
+            can_config.btr |= CAN_BTR_LBKM | CAN_BTR_SILM;
+            can_set_silent_mode(true);
+            break;
     };
 
+    chMtxLock(&can_tx_lock);
     can_is_running = true;
+    bit_clock_init(&can_bit_clock, can_bitrate);
+    // requests stopped with the channel never complete
+    tx_mailbox_init(&can_tx_mailboxes);
     canStart(&CAND1, &can_config);
+    chMtxUnlock(&can_tx_lock);
     chSemSignal(&can_config_wait);
 
     return true;
@@ -218,19 +707,183 @@ void can_close(void)
 {
     if (can_is_running) {
         chSemWait(&can_config_wait);
+        chMtxLock(&can_tx_lock);
         canStop(&CAND1);
         can_is_running = false;
+        chMtxUnlock(&can_tx_lock);
         can_rx_queue_flush();
+        can_rx_dropped = 0;
     }
 }
 
+#define CAN_BENCH_ID 0x7ff
+
+static struct can_bench_s can_bench;
+static volatile bool can_bench_active = false;
+MUTEX_DECL(can_bench_lock);
+
+// frames carry their transmit request time and sequence number
+static void can_bench_update(const struct can_frame_s* fp)
+{
+    if (!can_bench_active || fp->event || fp->extended || fp->id != CAN_BENCH_ID) {
+        return;
+    }
+    timestamp_t sent;
+    memcpy(&sent, &fp->data[0], sizeof(sent));
+    uint32_t latency = timestamp_get() - sent;
+    chMtxLock(&can_bench_lock);
+    histogram_add(&can_bench.latency, latency);
+    can_bench.received++;
+    chMtxUnlock(&can_bench_lock);
+}
+
+/* The benchmark runs in the I/O loop, which doesn't fetch meanwhile, so it
+ * fetches the frames itself. They aren't sent to the host. */
+static uint32_t can_bench_received(void)
+{
+    struct can_frame_s* fp;
+    while ((fp = can_receive()) != NULL) {
+        can_frame_delete(fp);
+    }
+    chMtxLock(&can_bench_lock);
+    uint32_t received = can_bench.received;
+    chMtxUnlock(&can_bench_lock);
+    return received;
+}
+
+bool can_bench_run(uint32_t duration, struct can_bench_s* result)
+{
+    if (can_is_running || duration > CAN_BENCH_MAX_DURATION) {
+        return false;
+    }
+    chMtxLock(&can_bench_lock);
+    memset(&can_bench, 0, sizeof(can_bench));
+    histogram_init(&can_bench.latency);
+    can_rx_high_water = 0;
+    can_bench_active = true;
+    chMtxUnlock(&can_bench_lock);
+
+    can_open(CAN_MODE_SILENT_LOOPBACK);
+    uint64_t idle = cpu_idle_cycles();
+    timestamp_t start = timestamp_get();
+    uint32_t seq = 0;
+    while ((uint32_t)timestamp_duration_us(start, timestamp_get()) < duration * 1000) {
+        uint8_t data[8];
+        timestamp_t now = timestamp_get();
+        memcpy(&data[0], &now, sizeof(now));
+        memcpy(&data[4], &seq, sizeof(seq));
+        if (!can_send(CAN_BENCH_ID, false, false, data, sizeof(data))) {
+            break;
+        }
+        seq++;
+        can_bench_received();
+    }
+    // let the receive path drain
+    unsigned int i;
+    for (i = 0; i < CAN_BENCH_DRAIN && can_bench_received() < seq; i++) {
+        chThdSleepMilliseconds(1);
+    }
+    uint32_t elapsed = timestamp_duration_us(start, timestamp_get());
+    idle = cpu_idle_cycles() - idle;
+    can_close();
+
+    chMtxLock(&can_bench_lock);
+    can_bench_active = false;
+    can_bench.sent = seq;
+    can_bench.elapsed = elapsed;
+    can_bench.busy = (uint64_t)elapsed * (STM32_SYSCLK / 1000000) - idle;
+    can_bench.queue_high_water = can_rx_high_water;
+    *result = can_bench;
+    chMtxUnlock(&can_bench_lock);
+    return true;
+}
+
+void can_bench_get(struct can_bench_s* result)
+{
+    chMtxLock(&can_bench_lock);
+    *result = can_bench;
+    chMtxUnlock(&can_bench_lock);
+}
+
+static uint16_t saturate_u16(uint32_t v)
+{
+    return v > UINT16_MAX ? UINT16_MAX : v;
+}
+
+// periodic CAN_EVENT_STATUS record
+static void can_status_poll(ltimestamp_t now)
+{
+    static timestamp_t last = 0;
+    uint32_t period = can_status_period;
+    if (period == 0 || timestamp_duration_us(last, now) < (int32_t)(period * 1000)) {
+        return;
+    }
+    last = now;
+    chSysLock();
+    unsigned int used = chMBGetUsedCountI(&can_rx_queue);
+    chSysUnlock();
+    uint16_t high_water = can_stats.queue_high_water;
+    uint16_t dropped = saturate_u16(can_stats.rx_dropped);
+    uint16_t bus_errors = saturate_u16(can_stats.bus_errors);
+    uint8_t data[8] = {used >> 8, used, high_water >> 8, high_water,
+                       dropped >> 8, dropped, bus_errors >> 8, bus_errors};
+    can_event_post(CAN_EVENT_STATUS, data, sizeof(data), now);
+}
+
+void can_stats_get(struct can_stats_s* s)
+{
+    chSysLock();
+    *s = can_stats;
+    chSysUnlock();
+    s->queue_size = can_rx_queue_size;
+}
+
+void can_stats_reset(void)
+{
+    chSysLock();
+    memset(&can_stats, 0, sizeof(can_stats));
+    can_stats.pool_high_water = can_rx_pool_used;
+    chSysUnlock();
+}
+
+void can_status_set_period(uint32_t period)
+{
+    can_status_period = period;
+}
+
+bool can_is_open(void)
+{
+    return can_is_running;
+}
+
+uint32_t can_get_bitrate(void)
+{
+    return can_bitrate;
+}
+
 void can_init(void)
 {
-    chMBObjectInit(&can_rx_queue, rx_mbox_buf, sizeof(rx_mbox_buf) / sizeof(rx_mbox_buf[0]));
-    chPoolObjectInit(&can_rx_pool, sizeof(rx_pool_buf[0]), NULL);
-    chPoolLoadArray(&can_rx_pool, rx_pool_buf, sizeof(rx_pool_buf) / sizeof(rx_pool_buf[0]));
+    // one queue entry and one record per frame
+    size_t avail = chCoreGetStatusX();
+    if (avail < CAN_RX_RAM_RESERVE) {
+        chSysHalt("CAN driver out of memory");
+    }
+    size_t size = (avail - CAN_RX_RAM_RESERVE) / (sizeof(msg_t) + sizeof(struct can_frame_s));
+    if (size <= CAN_RX_POOL_EXTRA) {
+        chSysHalt("CAN driver out of memory");
+    }
+    can_rx_queue_size = size - CAN_RX_POOL_EXTRA;
+    msg_t* mbox_buf = chCoreAlloc(can_rx_queue_size * sizeof(msg_t));
+    struct can_frame_s* pool_buf = chCoreAlloc(size * sizeof(struct can_frame_s));
+    chMBObjectInit(&can_rx_queue, mbox_buf, can_rx_queue_size);
+    chPoolObjectInit(&can_rx_pool, sizeof(struct can_frame_s), NULL);
+    chPoolLoadArray(&can_rx_pool, pool_buf, size);
 
     chSemObjectInit(&can_config_wait, 1);
+    period_monitor_init(&can_monitor);
+    capture_init(&can_capture);
+    histogram_init(&can_bench.latency);
+    latency_reset();
 
     uint32_t btr;
     if (!can_btr_from_bitrate(CAN_DEFAULT_BITRATE, &btr)) {
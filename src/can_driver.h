@@ -4,41 +4,160 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
+#include "period_monitor.h"
+#include "histogram.h"
+#include "tx_mailbox.h"
+#include <timestamp/timestamp.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Receive record, 16 bytes
+ * The flags share the first word with the ID, the length shares the second
+ * one with the timestamp. Sequence numbers aren't stored, see
+ * slcan_record_to_ascii().
+ */
 struct can_frame_s {
-    uint32_t timestamp;
     uint32_t id : 29;
     uint32_t extended : 1;
     uint32_t remote : 1;
-    uint8_t length;
+    uint32_t event : 1; // in-band event record, id holds the event type
+    uint32_t timestamp : 26; // [us] modulo CAN_TIMESTAMP_WRAP
+    uint32_t length : 4;
     uint8_t data[8];
 };
 
+/* the record timestamp wraps together with the 16 bit SLCAN timestamp [ms] */
+#define CAN_TIMESTAMP_WRAP (65536UL * 1000)
+
+/* record timestamp of a time of the 64 bit us clock */
+uint32_t can_timestamp(ltimestamp_t t);
+
+/* in-band event types, data holds the event payload */
+enum {
+    CAN_EVENT_DEADLINE_MISS = 1, // ID (bit 31 set if extended), time since last reception [us]
+    CAN_EVENT_BUS_ERROR = 2, // error flags, transmit and receive error counters
+    CAN_EVENT_CAPTURE_DONE = 3, // number of captured frames (16 bit)
+    CAN_EVENT_RX_OVERFLOW = 4, // number of frames dropped at this position
+    CAN_EVENT_HOST_OUTAGE = 5, // start [ms] and duration [ms] of a host outage
+    CAN_EVENT_STATUS = 6, // receive queue fill and high-water mark, drops, bus errors (16 bit each)
+    CAN_EVENT_TX_CREDIT = 7, // transmit credits granted since they were enabled (16 bit)
+};
+
+/* CAN_EVENT_BUS_ERROR flags */
+enum {
+    CAN_ERROR_WARNING = (1 << 0),
+    CAN_ERROR_PASSIVE = (1 << 1),
+    CAN_ERROR_BUS_OFF = (1 << 2),
+    CAN_ERROR_FRAME = (1 << 3),
+    CAN_ERROR_OVERFLOW = (1 << 4),
+};
+
 enum {
     CAN_MODE_NORMAL,
     CAN_MODE_LOOPBACK,
-    CAN_MODE_SILENT
+    CAN_MODE_SILENT,
+    CAN_MODE_SILENT_LOOPBACK, // internal loop back, the bus is not driven
 };
 
 /* non-blocking CAN frame receive, NULL if nothing received */
 struct can_frame_s* can_receive(void);
+/* the calling thread gets rx_events when a record is put into the receive
+ * queue and tx_events when a transmit mailbox is done */
+void can_notify(uint32_t rx_events, uint32_t tx_events);
+/* true if a transmit mailbox is free and accounted */
+bool can_tx_ready(void);
 void can_frame_delete(struct can_frame_s* f);
+/* time the frame was read from the controller [us], valid for 65 s */
+uint32_t can_frame_time(const struct can_frame_s* f);
 
 /* blocking CAN frame send */
 bool can_send(uint32_t id, bool extended, bool remote, uint8_t* data, size_t length);
+/* can_send() calling done with tag from the CAN receive thread when the
+ * transmission is done, see tx_mailbox.h */
+bool can_send_notify(uint32_t id, bool extended, bool remote, uint8_t* data, size_t length,
+                     tx_done_t done, uint32_t tag);
+/* can_send() for the frames of the host, accounts the time from start [us]
+ * to the completion of the transmission to LATENCY_TX_DONE and grants a
+ * transmit credit on completion */
+bool can_send_timed(uint32_t id, bool extended, bool remote, uint8_t* data, size_t length, uint32_t start);
 
 /* returns true on success, must be called before can_open */
 bool can_set_bitrate(uint32_t bitrate);
+uint32_t can_get_bitrate(void);
 
 /* returns true on success */
 bool can_open(int mode);
 void can_close(void);
+bool can_is_open(void);
 void can_init(void);
 
+/* periodic message monitor, period in us or 0 to learn it from the traffic */
+bool can_monitor_watch(uint32_t id, bool extended, uint32_t period);
+void can_monitor_clear(void);
+void can_monitor_reset(void);
+/* copies monitor entry i, returns false if the entry is unused */
+bool can_monitor_get(unsigned int i, struct period_monitor_entry_s* e);
+
+/* loop back self-benchmark results */
+struct can_bench_s {
+    uint32_t sent;
+    uint32_t received; // frames fetched from the receive queue
+    uint32_t elapsed; // [us]
+    uint64_t busy; // CPU cycles outside of the idle thread
+    unsigned int queue_high_water; // receive queue
+    struct histogram_s latency; // transmit request to receive queue fetch [us]
+};
+
+/* longest self-benchmark run [ms], the I/O loop serves neither commands
+ * nor the USB output meanwhile, it stays well under SLCAN_WRITE_TIMEOUT */
+#define CAN_BENCH_MAX_DURATION 40
+/* time left to the receive path to drain after a run [ms] */
+#define CAN_BENCH_DRAIN 10
+
+/* Runs the self-benchmark for duration [ms], blocks until it's done
+ * returns false if the channel is open or the duration is over
+ * CAN_BENCH_MAX_DURATION. The received frames are consumed by the
+ * benchmark.
+ */
+bool can_bench_run(uint32_t duration, struct can_bench_s* result);
+/* copies the results of the last run */
+void can_bench_get(struct can_bench_s* result);
+
+/* runtime counters */
+struct can_stats_s {
+    uint32_t rx_frames;
+    uint32_t tx_frames;
+    uint32_t rx_dropped; // receive queue full
+    uint32_t fifo_overruns; // controller receive FIFO overruns
+    uint32_t bus_errors; // error frames
+    unsigned int queue_high_water;
+    unsigned int pool_high_water;
+    unsigned int queue_size; // receive queue depth, set by the free RAM
+};
+
+void can_stats_get(struct can_stats_s* s);
+void can_stats_reset(void);
+/* period of the CAN_EVENT_STATUS record [ms], 0 to disable */
+void can_status_set_period(uint32_t period);
+
+/* Transmit credits
+ * Starts with one credit per transmit mailbox, every frame sent with
+ * can_send_timed() grants one more when it is done, with or without an
+ * error. Frames of the generator and replay grant none. The running total
+ * is reported with a CAN_EVENT_TX_CREDIT record when it changes.
+ */
+void can_tx_credit_enable(bool enable);
+
+struct capture_trigger_s;
+/* pre/post trigger capture of the received frames, see capture.h */
+bool can_capture_arm(const struct capture_trigger_s* t, unsigned int pre, unsigned int post);
+void can_capture_freeze(void);
+int can_capture_state(unsigned int* count);
+/* copies frame i of the capture, returns false past the last frame */
+bool can_capture_get(unsigned int i, struct can_frame_s* f);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,110 @@
+#include <stddef.h>
+#include "capture.h"
+
+void capture_init(struct capture_s* c)
+{
+    c->head = 0;
+    c->count = 0;
+    c->pre = 0;
+    c->post = 0;
+    c->remaining = 0;
+    c->state = CAPTURE_IDLE;
+}
+
+bool capture_arm(struct capture_s* c, const struct capture_trigger_s* t, unsigned int pre, unsigned int post)
+{
+    if (pre + post + 1 > CAPTURE_SIZE) {
+        return false;
+    }
+    c->head = 0;
+    c->count = 0;
+    c->pre = pre;
+    c->post = post;
+    c->remaining = post;
+    c->trigger = *t;
+    c->state = CAPTURE_ARMED;
+    return true;
+}
+
+void capture_freeze(struct capture_s* c)
+{
+    if (c->state != CAPTURE_IDLE) {
+        c->state = CAPTURE_DONE;
+    }
+}
+
+bool capture_trigger_match(const struct capture_trigger_s* t, const struct can_frame_s* f)
+{
+    unsigned int i;
+    switch (t->type) {
+        case CAPTURE_TRIGGER_FRAME:
+            if (f->event || f->extended != t->extended) {
+                return false;
+            }
+            if ((f->id & t->mask) != (t->id & t->mask)) {
+                return false;
+            }
+            if (t->length > 0 && (f->remote || f->length < t->length)) {
+                return false;
+            }
+            for (i = 0; i < t->length; i++) {
+                if ((f->data[i] & t->data_mask[i]) != (t->data[i] & t->data_mask[i])) {
+                    return false;
+                }
+            }
+            return true;
+        case CAPTURE_TRIGGER_ERROR:
+            return f->event && f->id == CAN_EVENT_BUS_ERROR
+                && (f->data[0] & CAN_ERROR_FRAME);
+        case CAPTURE_TRIGGER_BUS_OFF:
+            return f->event && f->id == CAN_EVENT_BUS_ERROR
+                && (f->data[0] & CAN_ERROR_BUS_OFF);
+    }
+    return false;
+}
+
+static void capture_push(struct capture_s* c, const struct can_frame_s* f)
+{
+    c->buf[c->head] = *f;
+    c->head = (c->head + 1) % CAPTURE_SIZE;
+    c->count++;
+}
+
+bool capture_frame(struct capture_s* c, const struct can_frame_s* f)
+{
+    switch (c->state) {
+        case CAPTURE_ARMED:
+            if (capture_trigger_match(&c->trigger, f)) {
+                capture_push(c, f);
+                c->state = CAPTURE_TRIGGERED;
+                break;
+            }
+            if (c->pre == 0) {
+                return false;
+            }
+            if (c->count == c->pre) {
+                c->count--; // drop the oldest frame
+            }
+            capture_push(c, f);
+            return false;
+        case CAPTURE_TRIGGERED:
+            capture_push(c, f);
+            c->remaining--;
+            break;
+        default:
+            return false;
+    }
+    if (c->remaining == 0) {
+        c->state = CAPTURE_DONE;
+        return true;
+    }
+    return false;
+}
+
+const struct can_frame_s* capture_get(const struct capture_s* c, unsigned int i)
+{
+    if (c->state == CAPTURE_IDLE || i >= c->count) {
+        return NULL;
+    }
+    return &c->buf[(c->head + CAPTURE_SIZE - c->count + i) % CAPTURE_SIZE];
+}
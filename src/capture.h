@@ -0,0 +1,75 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "can_driver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* capacity in frames, pre + post + 1 (the trigger frame) must fit */
+#define CAPTURE_SIZE 64
+
+enum {
+    CAPTURE_TRIGGER_FRAME, // ID and payload match
+    CAPTURE_TRIGGER_ERROR, // error frame on the bus
+    CAPTURE_TRIGGER_BUS_OFF,
+};
+
+enum {
+    CAPTURE_IDLE,
+    CAPTURE_ARMED, // recording, waiting for the trigger
+    CAPTURE_TRIGGERED, // recording the frames after the trigger
+    CAPTURE_DONE, // frozen, ready to be read
+};
+
+struct capture_trigger_s {
+    int type;
+    uint32_t id;
+    uint32_t mask;
+    bool extended;
+    uint8_t length; // number of payload bytes to match
+    uint8_t data[8];
+    uint8_t data_mask[8];
+};
+
+struct capture_s {
+    struct can_frame_s buf[CAPTURE_SIZE];
+    unsigned int head; // next write position
+    unsigned int count; // number of valid frames
+    unsigned int pre;
+    unsigned int post;
+    unsigned int remaining; // frames left to record after the trigger
+    int state;
+    struct capture_trigger_s trigger;
+};
+
+void capture_init(struct capture_s* c);
+
+/* Arm the capture
+ * keeps the pre frames before the trigger and the post frames after it.
+ * Returns false if they don't fit in the buffer.
+ */
+bool capture_arm(struct capture_s* c, const struct capture_trigger_s* t, unsigned int pre, unsigned int post);
+
+/* stop recording, the captured frames are kept */
+void capture_freeze(struct capture_s* c);
+
+/* Record a received frame or event record
+ * returns true when the capture just completed.
+ * Error triggers match CAN_EVENT_BUS_ERROR records.
+ */
+bool capture_frame(struct capture_s* c, const struct can_frame_s* f);
+
+bool capture_trigger_match(const struct capture_trigger_s* t, const struct can_frame_s* f);
+
+/* frame i of the capture, oldest first, NULL past the last frame */
+const struct can_frame_s* capture_get(const struct capture_s* c, unsigned int i);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAPTURE_H */
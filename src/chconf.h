@@ -46,7 +46,7 @@
  * @details Frequency of the system timer that drives the system ticks. This
  *          setting also defines the system tick time unit.
  */
-#define CH_CFG_ST_FREQUENCY 10000
+#define CH_CFG_ST_FREQUENCY 1000000
 
 /**
  * @brief   Time delta constant for the tick-less mode.
@@ -55,8 +55,14 @@
  *          of ticks that is safe to specify in a timeout directive.
  *          The value one is not valid, timeouts are rounded up to
  *          this value.
+ * @note    The alarm is programmed from a time read before the virtual
+ *          timer callbacks run, with the ADC and EXT interrupts above the
+ *          system timer. If that takes longer than the delta the compare
+ *          is missed and the counter wraps first, 71 minutes at 1 MHz.
+ *          50 us (3600 cycles) covers the callbacks and those interrupts
+ *          from flash with a wide margin.
  */
-#define CH_CFG_ST_TIMEDELTA 0
+#define CH_CFG_ST_TIMEDELTA 50
 
 /** @} */
 
@@ -384,7 +390,7 @@
  *
  * @note    The default is @p FALSE.
  */
-#define CH_DBG_FILL_THREADS FALSE
+#define CH_DBG_FILL_THREADS TRUE
 
 /**
  * @brief   Debug option, threads profiling.
@@ -442,9 +448,10 @@
  * @brief   Context switch hook.
  * @details This hook is invoked just before switching between threads.
  */
-#define CH_CFG_CONTEXT_SWITCH_HOOK(ntp, otp) \
-    {                                        \
-        /* Context switch code here.*/       \
+#define CH_CFG_CONTEXT_SWITCH_HOOK(ntp, otp)               \
+    {                                                      \
+        void cpu_context_switch(const void*, const void*); \
+        cpu_context_switch(ntp, otp);                      \
     }
 
 /**
@@ -453,8 +460,10 @@
  *          should be invoked from here.
  * @note    This macro can be used to activate a power saving mode.
  */
-#define CH_CFG_IDLE_ENTER_HOOK() \
-    {                            \
+#define CH_CFG_IDLE_ENTER_HOOK()    \
+    {                               \
+        void cpu_idle_enter(void);  \
+        cpu_idle_enter();           \
     }
 
 /**
@@ -463,8 +472,10 @@
  *          should be invoked from here.
  * @note    This macro can be used to deactivate a power saving mode.
  */
-#define CH_CFG_IDLE_LEAVE_HOOK() \
-    {                            \
+#define CH_CFG_IDLE_LEAVE_HOOK()    \
+    {                               \
+        void cpu_idle_leave(void);  \
+        cpu_idle_leave();           \
     }
 
 /**
@@ -481,9 +492,9 @@
  * @details This hook is invoked in the system tick handler immediately
  *          after processing the virtual timers queue.
  */
-#define CH_CFG_SYSTEM_TICK_HOOK()         \
-    {                                     \
-        /* System tick event code here.*/ \
+#define CH_CFG_SYSTEM_TICK_HOOK()                            \
+    {                                                        \
+        /* Tick-less, interrupts are sampled in cpu_load.c.*/ \
     }
 
 /**
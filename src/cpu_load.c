@@ -0,0 +1,185 @@
+#include <ch.h>
+#include <hal.h>
+#include <string.h>
+#include "cpu_load.h"
+#include "trace.h"
+
+// the main thread runs on the process stack, filled by the startup code
+extern uint8_t __process_stack_base__[];
+
+/* number of threads and interrupts that are accounted */
+#define CPU_LOAD_THREADS 10
+#define CPU_LOAD_IRQS 8
+
+static uint32_t idle_enter;
+static uint64_t idle_cycles;
+
+/* Threads are accounted exactly on context switches, interrupts interrupting
+ * a thread are included in its time. Interrupts are sampled about every ms
+ * by a virtual timer instead, using the NVIC active bits of the preempted
+ * interrupts. The period is varied with a LFSR so the samples don't lock to
+ * the 1 ms USB start of frame interrupt. */
+#define CPU_SAMPLE_PERIOD_MIN 500 // [us], plus 0 to 1023
+
+static virtual_timer_t sample_vt;
+static uint16_t sample_lfsr = 1;
+static struct {
+    const void* tp;
+    uint64_t cycles;
+} thread_load[CPU_LOAD_THREADS];
+static uint32_t switch_time;
+
+static struct {
+    int irq;
+    uint32_t samples;
+} irq_load[CPU_LOAD_IRQS];
+static uint32_t irq_samples;
+
+void cpu_load_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void cpu_idle_enter(void)
+{
+    idle_enter = DWT->CYCCNT;
+}
+
+void cpu_idle_leave(void)
+{
+    idle_cycles += DWT->CYCCNT - idle_enter;
+}
+
+void cpu_context_switch(const void* ntp, const void* otp)
+{
+    uint32_t now = DWT->CYCCNT;
+    trace_event(TRACE_SWITCH, (uint16_t)(uintptr_t)ntp);
+    unsigned int i;
+    for (i = 0; i < CPU_LOAD_THREADS; i++) {
+        if (thread_load[i].tp == otp || thread_load[i].tp == NULL) {
+            thread_load[i].tp = otp;
+            thread_load[i].cycles += now - switch_time;
+            break;
+        }
+    }
+    switch_time = now;
+}
+
+static void cpu_irq_sample(void)
+{
+    // the system timer interrupt serving the virtual timer is active
+    int self = (int)(SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk) - 16;
+    int irq = -1;
+    unsigned int i;
+    for (i = 0; i < 3 && irq < 0; i++) {
+        uint32_t active = NVIC->IABR[i];
+        if (self >= 0 && (unsigned int)self / 32 == i) {
+            active &= ~(1UL << (self % 32));
+        }
+        if (active != 0) {
+            irq = 32 * i + __builtin_ctz(active);
+        }
+    }
+    irq_samples++;
+    if (irq < 0) {
+        return;
+    }
+    trace_event(TRACE_IRQ, irq);
+    for (i = 0; i < CPU_LOAD_IRQS; i++) {
+        if (irq_load[i].irq == irq || irq_load[i].samples == 0) {
+            irq_load[i].irq = irq;
+            irq_load[i].samples++;
+            break;
+        }
+    }
+}
+
+static void cpu_sample(void* arg)
+{
+    (void)arg;
+    cpu_irq_sample();
+    sample_lfsr = (sample_lfsr >> 1) ^ (-(sample_lfsr & 1) & 0xb400);
+    chSysLockFromISR();
+    chVTSetI(&sample_vt, US2ST(CPU_SAMPLE_PERIOD_MIN + (sample_lfsr & 0x3ff)), cpu_sample, NULL);
+    chSysUnlockFromISR();
+}
+
+void cpu_load_start(void)
+{
+    chVTObjectInit(&sample_vt);
+    chVTSet(&sample_vt, US2ST(CPU_SAMPLE_PERIOD_MIN), cpu_sample, NULL);
+}
+
+void cpu_load_reset(void)
+{
+    chSysLock();
+    memset(thread_load, 0, sizeof(thread_load));
+    memset(irq_load, 0, sizeof(irq_load));
+    irq_samples = 0;
+    switch_time = DWT->CYCCNT;
+    chSysUnlock();
+}
+
+static unsigned int cpu_thread_load(const void* tp)
+{
+    uint64_t total = 0, cycles = 0;
+    unsigned int i;
+    chSysLock();
+    for (i = 0; i < CPU_LOAD_THREADS; i++) {
+        total += thread_load[i].cycles;
+        if (thread_load[i].tp == tp) {
+            cycles = thread_load[i].cycles;
+        }
+    }
+    chSysUnlock();
+    return total > 0 ? cycles * 1000 / total : 0;
+}
+
+bool cpu_isr_info(unsigned int i, struct cpu_isr_info_s* info)
+{
+    if (i >= CPU_LOAD_IRQS) {
+        return false;
+    }
+    chSysLock();
+    uint32_t samples = irq_load[i].samples;
+    uint32_t total = irq_samples;
+    info->irq = irq_load[i].irq;
+    chSysUnlock();
+    if (samples == 0) {
+        return false;
+    }
+    info->load = (uint64_t)samples * 1000 / total;
+    return true;
+}
+
+uint64_t cpu_idle_cycles(void)
+{
+    chSysLock();
+    uint64_t cycles = idle_cycles;
+    chSysUnlock();
+    return cycles;
+}
+
+bool cpu_thread_info(unsigned int i, struct cpu_thread_info_s* info)
+{
+    thread_t* tp = chRegFirstThread();
+    while (tp != NULL && i > 0) {
+        tp = chRegNextThread(tp);
+        i--;
+    }
+    if (tp == NULL) {
+        return false;
+    }
+    info->name = tp->p_name;
+    info->load = cpu_thread_load(tp);
+    // the stack grows down towards the thread structure at the start of the working area
+    const uint8_t* p = tp == &ch.mainthread ? __process_stack_base__ : (const uint8_t*)(tp + 1);
+    info->stack_unused = 0;
+    while (*p++ == CH_DBG_STACK_FILL_VALUE) {
+        info->stack_unused++;
+    }
+    chThdRelease(tp);
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef CPU_LOAD_H
+#define CPU_LOAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* starts the DWT cycle counter, call before chSysInit() */
+void cpu_load_init(void);
+
+/* starts sampling interrupts, call after chSysInit() */
+void cpu_load_start(void);
+
+/* called from the idle thread and context switch hooks in chconf.h */
+void cpu_idle_enter(void);
+void cpu_idle_leave(void);
+void cpu_context_switch(const void* ntp, const void* otp);
+
+/* restarts the load measurement */
+void cpu_load_reset(void);
+
+/* CPU cycles spent in the idle thread since startup */
+uint64_t cpu_idle_cycles(void);
+
+struct cpu_thread_info_s {
+    const char* name;
+    size_t stack_unused; // never used part of the stack [bytes]
+    unsigned int load; // CPU time since the last reset, including interrupts [0.1 %]
+};
+
+struct cpu_isr_info_s {
+    int irq; // NVIC interrupt number
+    unsigned int load; // sampled CPU time since the last reset [0.1 %]
+};
+
+/* information about the i-th thread of the registry, false past the last */
+bool cpu_thread_info(unsigned int i, struct cpu_thread_info_s* info);
+/* i-th interrupt seen active by the sampling timer, false past the last */
+bool cpu_isr_info(unsigned int i, struct cpu_isr_info_s* info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CPU_LOAD_H */
@@ -0,0 +1,103 @@
+#include "frame_bits.h"
+#include "ramfunc.h"
+
+// CRC delimiter, ACK slot and delimiter, end of frame
+#define FRAME_TAIL_BITS 10
+
+struct bit_stream_s {
+    unsigned int bits; // including stuff bits
+    unsigned int run; // equal bits in a row
+    unsigned int last;
+    uint16_t crc;
+};
+
+static RAMFUNC void stream_put(struct bit_stream_s* s, unsigned int bit)
+{
+    if (s->run == 5) {
+        // stuff bit of the opposite level
+        s->bits++;
+        s->last = !s->last;
+        s->run = 1;
+    }
+    s->bits++;
+    if (bit == s->last) {
+        s->run++;
+    } else {
+        s->last = bit;
+        s->run = 1;
+    }
+}
+
+static RAMFUNC void stream_put_crc(struct bit_stream_s* s, unsigned int bit)
+{
+    unsigned int next = bit ^ (s->crc >> 14);
+    s->crc = (s->crc << 1) & 0x7fff;
+    if (next) {
+        s->crc ^= 0x4599;
+    }
+    stream_put(s, bit);
+}
+
+static RAMFUNC void stream_put_field(struct bit_stream_s* s, uint32_t value, unsigned int bits)
+{
+    while (bits-- > 0) {
+        stream_put_crc(s, (value >> bits) & 1);
+    }
+}
+
+static RAMFUNC unsigned int data_length(const struct can_frame_s* f)
+{
+    if (f->remote) {
+        return 0;
+    }
+    return f->length > 8 ? 8 : f->length;
+}
+
+RAMFUNC unsigned int frame_bits(const struct can_frame_s* f)
+{
+    struct bit_stream_s s = {.bits = 0, .run = 0, .last = 2, .crc = 0};
+    unsigned int i;
+
+    stream_put_field(&s, 0, 1); // SOF
+    if (f->extended) {
+        stream_put_field(&s, f->id >> 18, 11);
+        stream_put_field(&s, 3, 2); // SRR, IDE
+        stream_put_field(&s, f->id, 18);
+        stream_put_field(&s, f->remote, 1);
+        stream_put_field(&s, 0, 2); // r1, r0
+    } else {
+        stream_put_field(&s, f->id, 11);
+        stream_put_field(&s, f->remote, 1);
+        stream_put_field(&s, 0, 2); // IDE, r0
+    }
+    stream_put_field(&s, f->length, 4);
+    for (i = 0; i < data_length(f); i++) {
+        stream_put_field(&s, f->data[i], 8);
+    }
+    uint16_t crc = s.crc;
+    for (i = 15; i-- > 0;) {
+        stream_put(&s, (crc >> i) & 1);
+    }
+    // a stuff bit after the last CRC bit still counts
+    if (s.run == 5) {
+        s.bits++;
+    }
+    return s.bits + FRAME_TAIL_BITS;
+}
+
+// SOF to the end of the CRC sequence, the stuffed part
+static RAMFUNC unsigned int stuffed_region(const struct can_frame_s* f)
+{
+    return (f->extended ? 54 : 34) + 8 * data_length(f);
+}
+
+RAMFUNC unsigned int frame_bits_unstuffed(const struct can_frame_s* f)
+{
+    return stuffed_region(f) + FRAME_TAIL_BITS;
+}
+
+RAMFUNC unsigned int frame_bits_max(const struct can_frame_s* f)
+{
+    unsigned int n = stuffed_region(f);
+    return n + (n - 1) / 4 + FRAME_TAIL_BITS;
+}
@@ -0,0 +1,29 @@
+#ifndef FRAME_BITS_H
+#define FRAME_BITS_H
+
+#include "can_driver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* On-wire length of classic CAN frames in bits
+ * From the start of frame to the end of frame, without the interframe
+ * space. Stuff bits are inserted from the start of frame to the end of the
+ * CRC sequence, after 5 equal bits.
+ */
+
+/* exact length, the CRC is computed to stuff it */
+unsigned int frame_bits(const struct can_frame_s* f);
+
+/* without stuff bits, the shortest possible length */
+unsigned int frame_bits_unstuffed(const struct can_frame_s* f);
+
+/* with the most stuff bits possible for the ID type and length */
+unsigned int frame_bits_max(const struct can_frame_s* f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAME_BITS_H */
@@ -0,0 +1,115 @@
+#include <string.h>
+#include "generator.h"
+
+static uint32_t generator_random(struct generator_s* g)
+{
+    // xorshift32
+    uint32_t x = g->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    g->random = x;
+    return x;
+}
+
+static uint32_t generator_range(struct generator_s* g, uint32_t min, uint32_t max)
+{
+    if (max <= min) {
+        return min;
+    }
+    return min + generator_random(g) % (max - min + 1);
+}
+
+void generator_init(struct generator_s* g, const struct generator_config_s* c, uint32_t seed)
+{
+    g->config = *c;
+    g->id = c->id_min;
+    g->random = seed != 0 ? seed : 1;
+    g->frames = 0;
+    g->sent = 0;
+    g->bits = 0;
+}
+
+void generator_next(struct generator_s* g, struct can_frame_s* f)
+{
+    const struct generator_config_s* c = &g->config;
+    uint32_t id_mask = c->extended ? 0x1fffffff : 0x7ff;
+
+    switch (c->id_mode) {
+        case GENERATOR_ID_INCREMENT:
+            f->id = g->id & id_mask;
+            g->id = g->id >= c->id_max ? c->id_min : g->id + 1;
+            break;
+        case GENERATOR_ID_RANDOM:
+            f->id = generator_range(g, c->id_min, c->id_max) & id_mask;
+            break;
+        default:
+            f->id = c->id_min & id_mask;
+            break;
+    }
+    f->extended = c->extended;
+    f->remote = false;
+    f->event = false;
+    f->length = generator_range(g, c->dlc_min, c->dlc_max);
+    if (f->length > 8) {
+        f->length = 8;
+    }
+
+    unsigned int i;
+    switch (c->data_mode) {
+        case GENERATOR_DATA_COUNTER:
+            memset(f->data, 0, sizeof(f->data));
+            for (i = 0; i < 4; i++) {
+                f->data[i] = g->frames >> (8 * i);
+            }
+            break;
+        case GENERATOR_DATA_RANDOM:
+            for (i = 0; i < 8; i += 4) {
+                uint32_t r = generator_random(g);
+                memcpy(&f->data[i], &r, 4);
+            }
+            break;
+        default:
+            memcpy(f->data, c->data, sizeof(f->data));
+            break;
+    }
+
+    g->frames++;
+}
+
+void generator_sent(struct generator_s* g, const struct can_frame_s* f)
+{
+    g->sent++;
+    g->bits += generator_frame_bits(f);
+}
+
+unsigned int generator_frame_bits(const struct can_frame_s* f)
+{
+    // SOF, arbitration, control, CRC, ACK, EOF and interframe space
+    unsigned int bits = f->extended ? 67 : 47;
+    if (!f->remote) {
+        bits += 8 * f->length;
+    }
+    return bits;
+}
+
+uint32_t generator_offset(const struct generator_s* g, uint32_t bitrate)
+{
+    const struct generator_config_s* c = &g->config;
+    if (c->rate != 0) {
+        return (uint64_t)g->frames * 1000000 / c->rate;
+    }
+    if (c->load == 0 || c->load >= 100 || bitrate == 0) {
+        return 0;
+    }
+    // the frames sent so far take bits / bitrate at 100 % load
+    return g->bits * 100000000 / ((uint64_t)bitrate * c->load);
+}
+
+unsigned int generator_load(const struct generator_s* g, uint32_t elapsed, uint32_t bitrate)
+{
+    if (elapsed == 0 || bitrate == 0) {
+        return 0;
+    }
+    return g->bits * 1000000000 / ((uint64_t)elapsed * bitrate);
+}
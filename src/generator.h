@@ -0,0 +1,69 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "can_driver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    GENERATOR_ID_FIXED, // always id_min
+    GENERATOR_ID_INCREMENT, // id_min to id_max, then wraps around
+    GENERATOR_ID_RANDOM, // uniform in id_min to id_max
+};
+
+enum {
+    GENERATOR_DATA_FIXED, // data
+    GENERATOR_DATA_COUNTER, // little endian frame counter
+    GENERATOR_DATA_RANDOM,
+};
+
+struct generator_config_s {
+    int id_mode;
+    uint32_t id_min;
+    uint32_t id_max;
+    bool extended;
+    uint8_t dlc_min; // DLC is uniform in dlc_min to dlc_max
+    uint8_t dlc_max;
+    int data_mode;
+    uint8_t data[8];
+    uint32_t rate; // frames/s, 0 to pace by bus load
+    unsigned int load; // bus load [%], 100 keeps the mailboxes full
+};
+
+struct generator_s {
+    struct generator_config_s config;
+    uint32_t id; // next ID in GENERATOR_ID_INCREMENT mode
+    uint32_t random; // xorshift state
+    uint32_t frames; // frames generated
+    uint32_t sent; // frames sent
+    uint64_t bits; // nominal bits of the sent frames
+};
+
+void generator_init(struct generator_s* g, const struct generator_config_s* c, uint32_t seed);
+
+/* fills in the next frame, timestamp is left untouched */
+void generator_next(struct generator_s* g, struct can_frame_s* f);
+
+/* the frame returned by generator_next() was sent */
+void generator_sent(struct generator_s* g, const struct can_frame_s* f);
+
+/* frame length on the wire without stuff bits, including the interframe space */
+unsigned int generator_frame_bits(const struct can_frame_s* f);
+
+/* start time of the next frame relative to the first one [us],
+ * 0 if the frame should be sent as soon as a mailbox is free
+ */
+uint32_t generator_offset(const struct generator_s* g, uint32_t bitrate);
+
+/* bus load of the sent frames over elapsed [0.1 %] */
+unsigned int generator_load(const struct generator_s* g, uint32_t elapsed, uint32_t bitrate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GENERATOR_H */
@@ -0,0 +1,145 @@
+#include <ch.h>
+#include <hal.h>
+#include <string.h>
+#include <timestamp/timestamp.h>
+#include <timestamp/timestamp_stm32.h>
+#include "generator.h"
+#include "generator_thread.h"
+
+/* the last us before a frame is due are spent polling the us timer, with
+ * the sleeps shorter than the minimum timeout CH_CFG_ST_TIMEDELTA */
+#define GENERATOR_SPIN_US 20
+
+static struct generator_s generator;
+static struct can_generator_stats_s generator_stats;
+static timestamp_t generator_start;
+static timestamp_t generator_end;
+MUTEX_DECL(generator_lock);
+BSEMAPHORE_DECL(generator_run, true);
+
+static event_listener_t generator_error_listener;
+
+// every transmission that completes with an error or lost arbitration counts once
+static void generator_tx_done(uint32_t tag, ltimestamp_t sof, bool ok)
+{
+    (void)tag;
+    (void)sof;
+    if (!ok) {
+        chMtxLock(&generator_lock);
+        generator_stats.failed++;
+        chMtxUnlock(&generator_lock);
+    }
+}
+
+static bool generator_running(void)
+{
+    chMtxLock(&generator_lock);
+    bool running = generator_stats.running;
+    chMtxUnlock(&generator_lock);
+    return running;
+}
+
+static bool generator_wait(timestamp_t deadline)
+{
+    while (1) {
+        int32_t wait = timestamp_duration_us(timestamp_get(), deadline);
+        if (wait <= 0) {
+            return true;
+        }
+        if (wait > GENERATOR_SPIN_US + CH_CFG_ST_TIMEDELTA) {
+            // sleep in short steps to notice when the generator is stopped
+            chThdSleep(wait > 10000 ? MS2ST(10) : TIMESTAMP_US2ST(wait - GENERATOR_SPIN_US));
+            if (!generator_running()) {
+                return false;
+            }
+        }
+    }
+}
+
+static THD_WORKING_AREA(generator_thread_wa, 256);
+static THD_FUNCTION(generator_thread, arg)
+{
+    (void)arg;
+    chRegSetThreadName("CAN generator");
+    chEvtRegisterMaskWithFlags(&CAND1.error_event, &generator_error_listener, EVENT_MASK(2), CAN_FRAMING_ERROR);
+    while (1) {
+        chBSemWait(&generator_run);
+        uint32_t bitrate = can_get_bitrate();
+        chEvtGetAndClearFlags(&generator_error_listener);
+        while (1) {
+            struct can_frame_s f;
+            chMtxLock(&generator_lock);
+            bool running = generator_stats.running;
+            uint32_t offset = generator_offset(&generator, bitrate);
+            generator_next(&generator, &f);
+            chMtxUnlock(&generator_lock);
+            if (!running || (offset != 0 && !generator_wait(generator_start + offset))) {
+                break;
+            }
+
+            bool ok = can_send_notify(f.id, f.extended, f.remote, f.data, f.length, generator_tx_done, 0);
+            eventflags_t errors = chEvtGetAndClearFlags(&generator_error_listener);
+
+            chMtxLock(&generator_lock);
+            if (ok) {
+                generator_sent(&generator, &f);
+            } else if (can_is_open()) {
+                generator_stats.timeouts++;
+            } else {
+                generator_stats.running = false;
+            }
+            if (errors) {
+                generator_stats.bus_errors++;
+            }
+            chMtxUnlock(&generator_lock);
+        }
+        chMtxLock(&generator_lock);
+        generator_stats.running = false;
+        generator_end = timestamp_get();
+        chMtxUnlock(&generator_lock);
+    }
+}
+
+bool can_generator_start(const struct generator_config_s* c)
+{
+    if (!can_is_open()) {
+        return false;
+    }
+    chMtxLock(&generator_lock);
+    bool ok = !generator_stats.running;
+    if (ok) {
+        generator_init(&generator, c, timestamp_get());
+        memset(&generator_stats, 0, sizeof(generator_stats));
+        generator_stats.running = true;
+        // leave time to the thread to get ready for the first frame
+        generator_start = timestamp_get() + 1000;
+    }
+    chMtxUnlock(&generator_lock);
+    if (ok) {
+        chBSemSignal(&generator_run);
+    }
+    return ok;
+}
+
+void can_generator_stop(void)
+{
+    chMtxLock(&generator_lock);
+    generator_stats.running = false;
+    chMtxUnlock(&generator_lock);
+}
+
+void can_generator_stats(struct can_generator_stats_s* s)
+{
+    chMtxLock(&generator_lock);
+    *s = generator_stats;
+    s->sent = generator.sent;
+    timestamp_t end = s->running ? timestamp_get() : generator_end;
+    int32_t elapsed = timestamp_duration_us(generator_start, end);
+    s->load = elapsed > 0 ? generator_load(&generator, elapsed, can_get_bitrate()) : 0;
+    chMtxUnlock(&generator_lock);
+}
+
+void can_generator_init(void)
+{
+    chThdCreateStatic(generator_thread_wa, sizeof(generator_thread_wa), NORMALPRIO - 1, generator_thread, NULL);
+}
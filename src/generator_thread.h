@@ -0,0 +1,33 @@
+#ifndef GENERATOR_THREAD_H
+#define GENERATOR_THREAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "generator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct can_generator_stats_s {
+    bool running;
+    uint32_t sent;
+    unsigned int load; // achieved bus load [0.1 %]
+    uint32_t timeouts; // no mailbox became free in time
+    uint32_t failed; // transmissions completed with an error or lost arbitration
+    uint32_t bus_errors; // error frames seen while generating
+};
+
+/* on-device traffic generator, see generator.h
+ * returns false if the channel is closed or the generator is running
+ */
+bool can_generator_start(const struct generator_config_s* c);
+void can_generator_stop(void);
+void can_generator_stats(struct can_generator_stats_s* s);
+void can_generator_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GENERATOR_THREAD_H */
@@ -0,0 +1,68 @@
+#include "hex.h"
+#include "ramfunc.h"
+
+/* both digits of every byte value */
+const char hex_pairs[512] =
+    "000102030405060708090a0b0c0d0e0f"
+    "101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f"
+    "303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f"
+    "505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f"
+    "707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f"
+    "909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf"
+    "b0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+    "d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+    "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+/* digit value with bit 4 set, 0 for anything else */
+static const uint8_t hex_table[256] = {
+    ['0'] = 0x10, ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13,
+    ['4'] = 0x14, ['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17,
+    ['8'] = 0x18, ['9'] = 0x19, ['a'] = 0x1a, ['b'] = 0x1b,
+    ['c'] = 0x1c, ['d'] = 0x1d, ['e'] = 0x1e, ['f'] = 0x1f,
+    ['A'] = 0x1a, ['B'] = 0x1b, ['C'] = 0x1c, ['D'] = 0x1d,
+    ['E'] = 0x1e, ['F'] = 0x1f,
+};
+
+#define HEX_VALID 0x10
+
+RAMFUNC bool hex_decode(uint8_t* dst, const char* src, size_t len)
+{
+    uint8_t valid = HEX_VALID;
+    while (len-- > 0) {
+        uint8_t hi = hex_table[(uint8_t)src[0]];
+        uint8_t lo = hex_table[(uint8_t)src[1]];
+        valid &= hi & lo;
+        *dst++ = (hi << 4) | (lo & 0x0f);
+        src += 2;
+    }
+    return valid != 0;
+}
+
+RAMFUNC bool hex_decode_u32(const char* src, unsigned int digits, uint32_t* val)
+{
+    uint8_t valid = HEX_VALID;
+    uint32_t v = 0;
+    while (digits-- > 0) {
+        uint8_t d = hex_table[(uint8_t)*src++];
+        valid &= d;
+        v = (v << 4) | (d & 0x0f);
+    }
+    *val = v;
+    return valid != 0;
+}
+
+bool hex_valid(const char* str, size_t len)
+{
+    uint8_t valid = HEX_VALID;
+    while (len-- > 0) {
+        valid &= hex_table[(uint8_t)*str++];
+    }
+    return valid != 0;
+}
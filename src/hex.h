@@ -0,0 +1,95 @@
+#ifndef HEX_H
+#define HEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Table driven hex codec
+ * Output is lower case, input may be either case. The decoders report
+ * invalid digits, every field from the host goes through them.
+ */
+
+static inline char hex_digit(uint8_t b)
+{
+    return "0123456789abcdef"[b & 0x0f];
+}
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "the hex encoder assumes a little endian target"
+#endif
+
+/* both digits of every byte value */
+extern const char hex_pairs[512];
+
+static inline uint16_t hex_pair(uint8_t b)
+{
+    uint16_t pair;
+    memcpy(&pair, &hex_pairs[2 * b], sizeof(pair));
+    return pair;
+}
+
+/* writes 2 * len digits, two bytes per 32 bit store */
+static inline void hex_encode(char* dst, const uint8_t* src, size_t len)
+{
+    while (len >= 2) {
+        uint32_t w = hex_pair(src[0]) | ((uint32_t)hex_pair(src[1]) << 16);
+        memcpy(dst, &w, sizeof(w));
+        dst += 4;
+        src += 2;
+        len -= 2;
+    }
+    if (len > 0) {
+        uint16_t pair = hex_pair(src[0]);
+        memcpy(dst, &pair, sizeof(pair));
+    }
+}
+
+/* writes the lowest digits of val, most significant first */
+static inline void hex_encode_u32(char* dst, uint32_t val, unsigned int digits)
+{
+    if (digits & 1) {
+        digits--;
+        *dst++ = hex_digit(val >> (4 * digits));
+    }
+    while (digits >= 4) {
+        digits -= 4;
+        uint32_t w = hex_pair(val >> (4 * digits + 8)) | ((uint32_t)hex_pair(val >> (4 * digits)) << 16);
+        memcpy(dst, &w, sizeof(w));
+        dst += 4;
+    }
+    if (digits == 2) {
+        uint16_t pair = hex_pair(val);
+        memcpy(dst, &pair, sizeof(pair));
+    }
+}
+
+/* decodes 2 * len digits, returns false if one isn't a hex digit */
+bool hex_decode(uint8_t* dst, const char* src, size_t len);
+/* returns false if one of the digits isn't a hex digit */
+bool hex_decode_u32(const char* src, unsigned int digits, uint32_t* val);
+bool hex_valid(const char* str, size_t len);
+
+/* advance *p past the written digits */
+static inline void hex_write(char** p, const uint8_t* data, uint8_t len)
+{
+    hex_encode(*p, data, len);
+    *p += 2 * len;
+}
+
+static inline void hex_write_u32(char** p, uint32_t val)
+{
+    hex_encode_u32(*p, val, 8);
+    *p += 8;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HEX_H */
@@ -0,0 +1,38 @@
+#include <string.h>
+#include "histogram.h"
+
+void histogram_init(struct histogram_s* h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min = UINT32_MAX;
+}
+
+unsigned int histogram_bin(uint32_t value)
+{
+    unsigned int bin = value == 0 ? 0 : 32 - __builtin_clz(value);
+    if (bin > HISTOGRAM_BINS - 1) {
+        bin = HISTOGRAM_BINS - 1;
+    }
+    return bin;
+}
+
+void histogram_add(struct histogram_s* h, uint32_t value)
+{
+    h->count++;
+    h->sum += value;
+    if (value < h->min) {
+        h->min = value;
+    }
+    if (value > h->max) {
+        h->max = value;
+    }
+    h->bins[histogram_bin(value)]++;
+}
+
+uint32_t histogram_mean(const struct histogram_s* h)
+{
+    if (h->count == 0) {
+        return 0;
+    }
+    return h->sum / h->count;
+}
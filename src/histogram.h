@@ -0,0 +1,33 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Log-scale histogram
+ * bin 0 counts 0, bin i counts values from 2^(i-1) to 2^i - 1, the last bin
+ * counts everything above.
+ */
+#define HISTOGRAM_BINS 16
+
+struct histogram_s {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t bins[HISTOGRAM_BINS];
+};
+
+void histogram_init(struct histogram_s* h);
+void histogram_add(struct histogram_s* h, uint32_t value);
+uint32_t histogram_mean(const struct histogram_s* h);
+unsigned int histogram_bin(uint32_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HISTOGRAM_H */
@@ -0,0 +1,36 @@
+#include <ch.h>
+#include <hal.h>
+#include <timestamp/timestamp.h>
+#include "latency.h"
+
+static struct histogram_s latency[LATENCY_STAGES];
+
+uint32_t latency_now(void)
+{
+    return timestamp_get();
+}
+
+void latency_add(unsigned int stage, uint32_t start)
+{
+    uint32_t elapsed = timestamp_get() - start;
+    chSysLock();
+    histogram_add(&latency[stage], elapsed);
+    chSysUnlock();
+}
+
+void latency_get(unsigned int stage, struct histogram_s* h)
+{
+    chSysLock();
+    *h = latency[stage];
+    chSysUnlock();
+}
+
+void latency_reset(void)
+{
+    unsigned int i;
+    for (i = 0; i < LATENCY_STAGES; i++) {
+        chSysLock();
+        histogram_init(&latency[i]);
+        chSysUnlock();
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include "histogram.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Per-stage latency histograms [us]
+ * receive stages count from the start of frame on the bus, transmit stages
+ * from the reception of the command line.
+ */
+enum {
+    LATENCY_RX_POST, // receive queue post
+    LATENCY_RX_FETCH, // fetch by the I/O loop
+    LATENCY_RX_ENCODE, // end of encoding
+    LATENCY_RX_WRITE, // USB transfer buffer posted
+    LATENCY_TX_MAILBOX, // transmit mailbox request accepted
+    LATENCY_TX_ACK, // ACK queued for output
+    LATENCY_TX_DONE, // transmission complete
+    LATENCY_STAGES,
+};
+
+/* current time [us] */
+uint32_t latency_now(void);
+
+/* accounts now - start to the stage */
+void latency_add(unsigned int stage, uint32_t start);
+
+/* copies the histogram of a stage */
+void latency_get(unsigned int stage, struct histogram_s* h);
+void latency_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LATENCY_H */
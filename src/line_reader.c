@@ -0,0 +1,32 @@
+#include <string.h>
+#include "line_reader.h"
+
+void line_reader_init(struct line_reader_s* r)
+{
+    r->len = 0;
+    r->overflow = false;
+}
+
+size_t line_reader_feed(struct line_reader_s* r, const char* data, size_t len, char** line)
+{
+    size_t n = 0;
+    *line = NULL;
+    while (n < len) {
+        char c = data[n++];
+        if (c == '\r' || c == '\n' || c == '\0') {
+            bool dropped = r->overflow;
+            r->line[r->len] = 0;
+            r->len = 0;
+            r->overflow = false;
+            if (!dropped) {
+                *line = r->line;
+                break;
+            }
+        } else if (r->len < sizeof(r->line) - 1) {
+            r->line[r->len++] = c;
+        } else {
+            r->overflow = true;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,33 @@
+#ifndef LINE_READER_H
+#define LINE_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LINE_READER_SIZE 500
+
+/* Splits a byte stream into command lines
+ * Lines end with CR, LF or NULL and may be split across any number of
+ * chunks. Lines longer than the buffer are dropped up to their terminator.
+ */
+struct line_reader_s {
+    char line[LINE_READER_SIZE];
+    size_t len;
+    bool overflow;
+};
+
+void line_reader_init(struct line_reader_s* r);
+/* consumes data up to and including the first terminator, returns the
+ * number of bytes consumed, *line points to the NULL terminated line if one
+ * is complete or is NULL */
+size_t line_reader_feed(struct line_reader_s* r, const char* data, size_t len, char** line);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LINE_READER_H */
@@ -5,6 +5,8 @@
 #include "can_driver.h"
 #include "slcan.h"
 #include "slcan_thread.h"
+#include "cpu_load.h"
+#include "trace.h"
 #include <timestamp/timestamp.h>
 #include <timestamp/timestamp_stm32.h>
 
@@ -38,7 +40,10 @@ void user_button_poll(void)
 int main(void)
 {
     halInit();
+    cpu_load_init();
     chSysInit();
+    cpu_load_start();
+    trace_start();
 
     chSysLock();
     timestamp_stm32_init();
@@ -0,0 +1,143 @@
+#include <string.h>
+#include "period_monitor.h"
+
+static void entry_reset(struct period_monitor_entry_s* e)
+{
+    e->seen = false;
+    e->late = false;
+    e->count = 0;
+    e->min = UINT32_MAX;
+    e->max = 0;
+    e->sum = 0;
+    e->missed = 0;
+    memset(e->hist, 0, sizeof(e->hist));
+}
+
+static struct period_monitor_entry_s* entry_find(struct period_monitor_s* m, uint32_t id, bool extended)
+{
+    unsigned int i;
+    for (i = 0; i < PERIOD_MONITOR_SIZE; i++) {
+        struct period_monitor_entry_s* e = &m->entries[i];
+        if (e->active && e->id == id && e->extended == extended) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+void period_monitor_init(struct period_monitor_s* m)
+{
+    memset(m, 0, sizeof(*m));
+}
+
+bool period_monitor_watch(struct period_monitor_s* m, uint32_t id, bool extended, uint32_t period)
+{
+    struct period_monitor_entry_s* e = entry_find(m, id, extended);
+    unsigned int i;
+    for (i = 0; e == NULL && i < PERIOD_MONITOR_SIZE; i++) {
+        if (!m->entries[i].active) {
+            e = &m->entries[i];
+        }
+    }
+    if (e == NULL) {
+        return false;
+    }
+    e->id = id;
+    e->extended = extended;
+    e->active = true;
+    e->period = period;
+    entry_reset(e);
+    return true;
+}
+
+void period_monitor_reset(struct period_monitor_s* m)
+{
+    unsigned int i;
+    for (i = 0; i < PERIOD_MONITOR_SIZE; i++) {
+        entry_reset(&m->entries[i]);
+    }
+}
+
+unsigned int period_monitor_hist_bin(uint32_t deviation)
+{
+    unsigned int bin = 0;
+    uint32_t limit = 16;
+    while (bin < PERIOD_MONITOR_HIST_BINS - 1 && deviation >= limit) {
+        limit <<= 2;
+        bin++;
+    }
+    return bin;
+}
+
+struct period_monitor_entry_s* period_monitor_update(struct period_monitor_s* m, uint32_t id, bool extended, uint32_t now, uint32_t* elapsed)
+{
+    struct period_monitor_entry_s* e = entry_find(m, id, extended);
+    if (e == NULL) {
+        return NULL;
+    }
+    if (!e->seen) {
+        e->seen = true;
+        e->last = now;
+        return NULL;
+    }
+
+    uint32_t interval = now - e->last;
+    *elapsed = interval;
+    bool reported = e->late;
+    e->last = now;
+    e->late = false;
+
+    e->count++;
+    e->sum += interval;
+    if (interval < e->min) {
+        e->min = interval;
+    }
+    if (interval > e->max) {
+        e->max = interval;
+    }
+
+    if (e->period == 0) {
+        if (e->count >= PERIOD_MONITOR_LEARN_COUNT) {
+            e->period = period_monitor_mean(e);
+        }
+        return NULL;
+    }
+
+    uint32_t deviation = interval > e->period ? interval - e->period : e->period - interval;
+    uint16_t* bin = &e->hist[period_monitor_hist_bin(deviation)];
+    if (*bin < UINT16_MAX) {
+        (*bin)++;
+    }
+
+    if (!reported && interval > PERIOD_MONITOR_DEADLINE(e->period)) {
+        e->missed++;
+        return e;
+    }
+    return NULL;
+}
+
+struct period_monitor_entry_s* period_monitor_check(struct period_monitor_s* m, uint32_t now, uint32_t* elapsed)
+{
+    unsigned int i;
+    for (i = 0; i < PERIOD_MONITOR_SIZE; i++) {
+        struct period_monitor_entry_s* e = &m->entries[i];
+        if (!e->active || !e->seen || e->late || e->period == 0) {
+            continue;
+        }
+        if (now - e->last > PERIOD_MONITOR_DEADLINE(e->period)) {
+            *elapsed = now - e->last;
+            e->late = true;
+            e->missed++;
+            return e;
+        }
+    }
+    return NULL;
+}
+
+uint32_t period_monitor_mean(const struct period_monitor_entry_s* e)
+{
+    if (e->count == 0) {
+        return 0;
+    }
+    return (uint32_t)(e->sum / e->count);
+}
@@ -0,0 +1,74 @@
+#ifndef PERIOD_MONITOR_H
+#define PERIOD_MONITOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PERIOD_MONITOR_SIZE 8
+
+/* number of intervals averaged when the period of an ID is learned */
+#define PERIOD_MONITOR_LEARN_COUNT 8
+
+/* Jitter histogram
+ * bin i counts intervals deviating less than 16 * 4^i us from the period,
+ * the last bin counts everything above.
+ */
+#define PERIOD_MONITOR_HIST_BINS 8
+
+/* a deadline is missed when nothing arrived for 1.5 periods */
+#define PERIOD_MONITOR_DEADLINE(period) ((period) + (period) / 2)
+
+struct period_monitor_entry_s {
+    uint32_t id;
+    bool extended;
+    bool active;
+    bool seen; // at least one frame received
+    bool late; // deadline miss already reported for the current interval
+    uint32_t period; // expected period [us], 0 while learning
+    uint32_t last; // timestamp of the last reception [us]
+    uint32_t count; // number of measured intervals
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t missed;
+    uint16_t hist[PERIOD_MONITOR_HIST_BINS];
+};
+
+struct period_monitor_s {
+    struct period_monitor_entry_s entries[PERIOD_MONITOR_SIZE];
+};
+
+void period_monitor_init(struct period_monitor_s* m);
+
+/* watch an ID, period in us or 0 to learn it, returns false when full */
+bool period_monitor_watch(struct period_monitor_s* m, uint32_t id, bool extended, uint32_t period);
+
+/* clear statistics but keep watched IDs and their periods */
+void period_monitor_reset(struct period_monitor_s* m);
+
+/* Account a received frame
+ * returns the entry if the frame arrived after its deadline and the miss was
+ * not already reported by period_monitor_check(), NULL otherwise.
+ * elapsed is set to the time since the previous reception of the ID.
+ */
+struct period_monitor_entry_s* period_monitor_update(struct period_monitor_s* m, uint32_t id, bool extended, uint32_t now, uint32_t* elapsed);
+
+/* Look for expired deadlines
+ * returns the next entry that missed its deadline, NULL when there is none.
+ * Each miss is reported only once, call repeatedly until NULL.
+ * elapsed is set to the time since the last reception of the ID.
+ */
+struct period_monitor_entry_s* period_monitor_check(struct period_monitor_s* m, uint32_t now, uint32_t* elapsed);
+
+uint32_t period_monitor_mean(const struct period_monitor_entry_s* e);
+unsigned int period_monitor_hist_bin(uint32_t deviation);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PERIOD_MONITOR_H */
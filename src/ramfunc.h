@@ -0,0 +1,24 @@
+#ifndef RAMFUNC_H
+#define RAMFUNC_H
+
+/* Functions on the receive and transmit path run from SRAM
+ * Flash runs with 2 wait states at 72 MHz. Functions marked RAMFUNC are put
+ * in .ramtext, which is copied to SRAM with the initialized data at startup
+ * (rules/rules.ld). The CAN driver's interrupt handlers are placed there by
+ * the linker script, with the libgcc 64 bit division. Constant tables (the
+ * hex codec) stay in flash, SRAM is left to the receive queue. With
+ * RAMFUNC_O2 (USE_RAMFUNC_O2 in the Makefile) the functions are compiled at
+ * -O2 instead of -Os. Kernel and HAL calls (mailboxes, pools, events,
+ * canReceive) and memcpy stay in flash. Nothing changes on the host.
+ */
+#if defined(__arm__)
+#if defined(RAMFUNC_O2)
+#define RAMFUNC __attribute__((section(".ramtext"), optimize("O2")))
+#else
+#define RAMFUNC __attribute__((section(".ramtext")))
+#endif
+#else
+#define RAMFUNC
+#endif
+
+#endif /* RAMFUNC_H */
@@ -0,0 +1,95 @@
+#include <string.h>
+#include "record_queue.h"
+#include "ramfunc.h"
+
+#define RECORD_HEADER_LEN 2
+
+void record_queue_init(struct record_queue_s* q, uint8_t* buf, uint32_t size)
+{
+    q->buf = buf;
+    q->size = size;
+    q->head = 0;
+    q->tail = 0;
+}
+
+static uint32_t record_size(size_t len)
+{
+    return (RECORD_HEADER_LEN + len + 1) & ~1u;
+}
+
+static void header_write(struct record_queue_s* q, uint32_t pos, size_t len)
+{
+    q->buf[pos] = len;
+    q->buf[pos + 1] = len >> 8;
+}
+
+static size_t header_read(const struct record_queue_s* q, uint32_t pos)
+{
+    return q->buf[pos] | (q->buf[pos + 1] << 8);
+}
+
+RAMFUNC void* record_queue_reserve(struct record_queue_s* q, size_t len)
+{
+    if (len == 0 || len > UINT16_MAX) {
+        return NULL;
+    }
+    uint32_t need = record_size(len);
+    uint32_t room = q->size - (q->head - q->tail);
+    uint32_t pos = q->head & (q->size - 1);
+    uint32_t end = q->size - pos;
+    if (end < need) {
+        // skip the end of the buffer
+        if (room < end + need) {
+            return NULL;
+        }
+        header_write(q, pos, 0);
+        q->head += end;
+        pos = 0;
+    } else if (room < need) {
+        return NULL;
+    }
+    return &q->buf[pos + RECORD_HEADER_LEN];
+}
+
+RAMFUNC void record_queue_commit(struct record_queue_s* q, size_t len)
+{
+    header_write(q, q->head & (q->size - 1), len);
+    q->head += record_size(len);
+}
+
+RAMFUNC bool record_queue_push(struct record_queue_s* q, const void* data, size_t len)
+{
+    void* p = record_queue_reserve(q, len);
+    if (p == NULL) {
+        return false;
+    }
+    memcpy(p, data, len);
+    record_queue_commit(q, len);
+    return true;
+}
+
+RAMFUNC const void* record_queue_front(struct record_queue_s* q, size_t* len)
+{
+    while (!record_queue_empty(q)) {
+        uint32_t pos = q->tail & (q->size - 1);
+        *len = header_read(q, pos);
+        if (*len > 0) {
+            return &q->buf[pos + RECORD_HEADER_LEN];
+        }
+        q->tail += q->size - pos;
+    }
+    return NULL;
+}
+
+RAMFUNC void record_queue_pop(struct record_queue_s* q)
+{
+    size_t len;
+    if (record_queue_front(q, &len) != NULL) {
+        q->tail += record_size(len);
+    }
+}
+
+bool record_queue_empty(const struct record_queue_s* q)
+{
+    return q->head == q->tail;
+}
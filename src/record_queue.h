@@ -0,0 +1,43 @@
+#ifndef RECORD_QUEUE_H
+#define RECORD_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Queue of variable length records
+ * Records are stored contiguous with a 16 bit length prefix, aligned to 2
+ * bytes, a zero length marks the unused end of the buffer. Producers can
+ * encode in place between reserve and commit, the consumer reads the
+ * oldest record in place. Not thread safe, see slcan_thread.c.
+ */
+struct record_queue_s {
+    uint8_t* buf;
+    uint32_t size; // power of 2
+    uint32_t head; // bytes ever pushed
+    uint32_t tail; // bytes ever popped
+};
+
+void record_queue_init(struct record_queue_s* q, uint8_t* buf, uint32_t size);
+/* returns room for a record of up to len bytes or NULL if the queue is too
+ * full, only one reservation may be open at a time */
+void* record_queue_reserve(struct record_queue_s* q, size_t len);
+/* pushes the first len bytes of the reserved room */
+void record_queue_commit(struct record_queue_s* q, size_t len);
+/* returns false if there is not enough room for the record */
+bool record_queue_push(struct record_queue_s* q, const void* data, size_t len);
+/* oldest record or NULL if the queue is empty */
+const void* record_queue_front(struct record_queue_s* q, size_t* len);
+/* drops the oldest record */
+void record_queue_pop(struct record_queue_s* q);
+bool record_queue_empty(const struct record_queue_s* q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RECORD_QUEUE_H */
@@ -0,0 +1,137 @@
+#include <stddef.h>
+#include "replay.h"
+
+static uint32_t replay_scale(const struct replay_s* r, uint32_t t)
+{
+    return (uint64_t)t * 100 / r->speed;
+}
+
+static unsigned int replay_slot(unsigned int i)
+{
+    return i % REPLAY_SIZE;
+}
+
+void replay_init(struct replay_s* r)
+{
+    r->first = 0;
+    r->count = 0;
+    r->duration = 0;
+    r->speed = 100;
+    r->loops = 1;
+    r->loop = 0;
+    r->next = 0;
+    r->state = REPLAY_IDLE;
+}
+
+bool replay_add(struct replay_s* r, const struct can_frame_s* f, uint32_t offset)
+{
+    bool streaming = r->state == REPLAY_RUNNING && r->loops == 1;
+    if (r->state != REPLAY_IDLE && !streaming) {
+        return false;
+    }
+    if (r->count > 0 && offset < r->offset[replay_slot(r->first + r->count - 1)]) {
+        return false;
+    }
+    if (r->count >= REPLAY_SIZE) {
+        // a single run doesn't need the frames it already sent
+        if (!streaming || r->next == r->first) {
+            return false;
+        }
+        r->first++;
+        r->count--;
+    }
+    unsigned int i = replay_slot(r->first + r->count);
+    r->frames[i] = *f;
+    r->offset[i] = offset;
+    r->error[i] = 0;
+    r->count++;
+    return true;
+}
+
+uint32_t replay_duration(const struct replay_s* r)
+{
+    if (r->count == 0) {
+        return 0;
+    }
+    uint32_t first = r->offset[replay_slot(r->first)];
+    uint32_t last = r->offset[replay_slot(r->first + r->count - 1)];
+    if (r->duration > last) {
+        return r->duration;
+    }
+    // loop with the mean frame spacing between the last and the first frame
+    if (r->count > 1) {
+        return last + (last - first) / (r->count - 1);
+    }
+    return last;
+}
+
+bool replay_start(struct replay_s* r, unsigned int speed, unsigned int loops, uint32_t now)
+{
+    if (r->count == 0 || speed == 0) {
+        return false;
+    }
+    r->speed = speed;
+    r->loops = loops;
+    r->loop = 0;
+    r->next = r->first;
+    r->start = now;
+    r->previous = now;
+    r->state = REPLAY_RUNNING;
+    return true;
+}
+
+void replay_stop(struct replay_s* r)
+{
+    r->state = REPLAY_IDLE;
+}
+
+const struct can_frame_s* replay_next(struct replay_s* r, unsigned int* seq, uint32_t* deadline)
+{
+    if (r->state != REPLAY_RUNNING) {
+        return NULL;
+    }
+    unsigned int i = replay_slot(r->next);
+    *seq = r->next;
+    *deadline = r->start + replay_scale(r, r->offset[i]);
+    return &r->frames[i];
+}
+
+void replay_sent(struct replay_s* r, uint32_t now)
+{
+    if (r->state != REPLAY_RUNNING) {
+        return;
+    }
+    unsigned int i = replay_slot(r->next);
+    r->error[i] = now - (r->start + replay_scale(r, r->offset[i]));
+    r->next++;
+    if (r->next != r->first + r->count) {
+        return;
+    }
+    r->next = r->first;
+    r->loop++;
+    r->previous = r->start;
+    r->start += replay_scale(r, replay_duration(r));
+    if (r->loops != 0 && r->loop >= r->loops) {
+        r->state = REPLAY_IDLE;
+    }
+}
+
+void replay_done(struct replay_s* r, unsigned int seq, uint32_t sof)
+{
+    // dropped meanwhile to make room
+    if (seq - r->first >= r->count) {
+        return;
+    }
+    uint32_t start = seq - r->first < r->next - r->first ? r->start : r->previous;
+    unsigned int i = replay_slot(seq);
+    r->error[i] = sof - (start + replay_scale(r, r->offset[i]));
+}
+
+bool replay_error(const struct replay_s* r, unsigned int i, int32_t* error)
+{
+    if (i >= r->count) {
+        return false;
+    }
+    *error = r->error[replay_slot(r->first + i)];
+    return true;
+}
@@ -0,0 +1,73 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "can_driver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define REPLAY_SIZE 64
+
+enum {
+    REPLAY_IDLE,
+    REPLAY_RUNNING,
+};
+
+/* Trace replay
+ * Frames are stored with their offset from the start of the trace [us] and
+ * are sent at start + offset * 100 / speed.
+ * The frames are a ring indexed by sequence numbers, during a single run
+ * frames can be appended while it runs, the oldest sent frame makes room
+ * for them. Looping traces are kept whole.
+ */
+struct replay_s {
+    struct can_frame_s frames[REPLAY_SIZE];
+    uint32_t offset[REPLAY_SIZE];
+    int32_t error[REPLAY_SIZE]; // start of frame - scheduled send time of the last run [us]
+    unsigned int first; // oldest stored frame
+    unsigned int count;
+    uint32_t duration; // loop period [us], 0 to derive it from the offsets
+    unsigned int speed; // percent of the recorded speed
+    unsigned int loops; // number of runs, 0 for forever
+    unsigned int loop; // current run
+    unsigned int next; // next frame to send, from first to first + count
+    uint32_t start; // start of the current run [us]
+    uint32_t previous; // start of the previous run [us]
+    int state;
+};
+
+void replay_init(struct replay_s* r);
+
+/* append a frame, offsets must not decrease, returns false when full or
+ * when a looping trace runs */
+bool replay_add(struct replay_s* r, const struct can_frame_s* f, uint32_t offset);
+
+/* length of one run of the trace, before speed scaling [us] */
+uint32_t replay_duration(const struct replay_s* r);
+
+bool replay_start(struct replay_s* r, unsigned int speed, unsigned int loops, uint32_t now);
+void replay_stop(struct replay_s* r);
+
+/* next frame to send, its sequence number and when, NULL when the replay
+ * is over */
+const struct can_frame_s* replay_next(struct replay_s* r, unsigned int* seq, uint32_t* deadline);
+
+/* the frame returned by replay_next() was handed to the controller at the
+ * given time, its error is the one of the hand over until it is done */
+void replay_sent(struct replay_s* r, uint32_t now);
+
+/* the transmission of frame seq started at sof, a frame of the previous run
+ * if it wasn't sent in the current one yet */
+void replay_done(struct replay_s* r, unsigned int seq, uint32_t sof);
+
+/* send time error of the i-th stored frame, false past the last one */
+bool replay_error(const struct replay_s* r, unsigned int i, int32_t* error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REPLAY_H */
@@ -0,0 +1,153 @@
+#include <ch.h>
+#include <hal.h>
+#include <timestamp/timestamp.h>
+#include <timestamp/timestamp_stm32.h>
+#include "replay.h"
+#include "replay_thread.h"
+
+/* the last us before a deadline are spent polling the us timer, they cover
+ * the wake up latency of the tick-less system timer. Sleeps shorter than
+ * CH_CFG_ST_TIMEDELTA would be rounded up, they are polled as well. */
+#define REPLAY_SPIN_US 20
+
+static struct replay_s replay;
+MUTEX_DECL(replay_lock);
+BSEMAPHORE_DECL(replay_run, true);
+
+static bool replay_wait(uint32_t deadline)
+{
+    while (1) {
+        int32_t wait = timestamp_duration_us(timestamp_get(), deadline);
+        if (wait <= 0) {
+            return true;
+        }
+        if (wait <= REPLAY_SPIN_US + CH_CFG_ST_TIMEDELTA) {
+            continue;
+        }
+        // sleep in short steps to notice when the replay is stopped
+        if (wait > 10000 + REPLAY_SPIN_US) {
+            chThdSleepMilliseconds(10);
+        } else {
+            chThdSleep(TIMESTAMP_US2ST(wait - REPLAY_SPIN_US));
+        }
+        chMtxLock(&replay_lock);
+        bool running = replay.state == REPLAY_RUNNING;
+        chMtxUnlock(&replay_lock);
+        if (!running) {
+            return false;
+        }
+    }
+}
+
+// the error of a frame is taken at the start of frame of its transmission
+static void replay_tx_done(uint32_t seq, ltimestamp_t sof, bool ok)
+{
+    (void)ok;
+    chMtxLock(&replay_lock);
+    replay_done(&replay, seq, sof);
+    chMtxUnlock(&replay_lock);
+}
+
+static THD_WORKING_AREA(replay_thread_wa, 256);
+static THD_FUNCTION(replay_thread, arg)
+{
+    (void)arg;
+    chRegSetThreadName("CAN replay");
+    while (1) {
+        chBSemWait(&replay_run);
+        while (1) {
+            struct can_frame_s f;
+            unsigned int seq;
+            uint32_t deadline;
+            chMtxLock(&replay_lock);
+            const struct can_frame_s* fp = replay_next(&replay, &seq, &deadline);
+            if (fp != NULL) {
+                f = *fp;
+            }
+            chMtxUnlock(&replay_lock);
+            if (fp == NULL || !replay_wait(deadline)) {
+                break;
+            }
+
+            bool ok = can_send_notify(f.id, f.extended, f.remote, f.data, f.length, replay_tx_done, seq);
+            timestamp_t now = timestamp_get();
+
+            chMtxLock(&replay_lock);
+            if (ok) {
+                replay_sent(&replay, now);
+            } else {
+                replay_stop(&replay);
+            }
+            chMtxUnlock(&replay_lock);
+        }
+    }
+}
+
+void can_replay_clear(void)
+{
+    chMtxLock(&replay_lock);
+    replay_init(&replay);
+    chMtxUnlock(&replay_lock);
+}
+
+bool can_replay_add(const struct can_frame_s* f, uint32_t offset)
+{
+    chMtxLock(&replay_lock);
+    bool ok = replay_add(&replay, f, offset);
+    chMtxUnlock(&replay_lock);
+    return ok;
+}
+
+void can_replay_set_duration(uint32_t duration)
+{
+    chMtxLock(&replay_lock);
+    replay.duration = duration;
+    chMtxUnlock(&replay_lock);
+}
+
+bool can_replay_start(unsigned int speed, unsigned int loops)
+{
+    chMtxLock(&replay_lock);
+    bool ok = replay.state == REPLAY_IDLE;
+    if (ok) {
+        // leave time to the thread to get ready for the first frame
+        ok = replay_start(&replay, speed, loops, timestamp_get() + 1000);
+    }
+    chMtxUnlock(&replay_lock);
+    if (ok) {
+        chBSemSignal(&replay_run);
+    }
+    return ok;
+}
+
+void can_replay_stop(void)
+{
+    chMtxLock(&replay_lock);
+    replay_stop(&replay);
+    chMtxUnlock(&replay_lock);
+}
+
+int can_replay_state(unsigned int* count, unsigned int* next, unsigned int* loop)
+{
+    chMtxLock(&replay_lock);
+    int state = replay.state;
+    *count = replay.count;
+    *next = replay.next - replay.first;
+    *loop = replay.loop;
+    chMtxUnlock(&replay_lock);
+    return state;
+}
+
+bool can_replay_error(unsigned int i, int32_t* error)
+{
+    chMtxLock(&replay_lock);
+    bool ok = replay_error(&replay, i, error);
+    chMtxUnlock(&replay_lock);
+    return ok;
+}
+
+void can_replay_init(void)
+{
+    replay_init(&replay);
+    chThdCreateStatic(replay_thread_wa, sizeof(replay_thread_wa), NORMALPRIO + 1, replay_thread, NULL);
+}
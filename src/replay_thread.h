@@ -0,0 +1,28 @@
+#ifndef REPLAY_THREAD_H
+#define REPLAY_THREAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "can_driver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* on-device trace replay, see replay.h */
+void can_replay_clear(void);
+bool can_replay_add(const struct can_frame_s* f, uint32_t offset);
+void can_replay_set_duration(uint32_t duration);
+bool can_replay_start(unsigned int speed, unsigned int loops);
+void can_replay_stop(void);
+/* returns the replay state, number of frames, current frame and run */
+int can_replay_state(unsigned int* count, unsigned int* next, unsigned int* loop);
+/* timing error of frame i in the last run [us], returns false past the end */
+bool can_replay_error(unsigned int i, int32_t* error);
+void can_replay_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REPLAY_THREAD_H */
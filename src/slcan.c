@@ -6,72 +6,79 @@
 #include "can_driver.h"
 #include "slcan.h"
 #include "bus_power.h"
-
-#define MAX_FRAME_LEN (sizeof("T1111222281122334455667788EA5F\r") + 1)
+#include "capture.h"
+#include "replay.h"
+#include "replay_thread.h"
+#include "generator.h"
+#include "generator_thread.h"
+#include "latency.h"
+#include "cpu_load.h"
+#include "trace.h"
+#include "hex.h"
+#include "usb_sof.h"
+#include "ramfunc.h"
 
 int slcan_serial_write(void* arg, const char* buf, size_t len);
+/* room for one record of the receive stream, encoded in place, NULL if the
+ * output is full, the commit times the frame from start [us] until it is
+ * written */
+char* slcan_serial_reserve(void* arg, size_t len);
+void slcan_serial_commit(void* arg, size_t len, uint32_t start);
 char* slcan_getline(void* arg);
+bool slcan_host_ready(void* arg);
+void slcan_serial_stats(uint32_t* written, uint32_t* timeouts);
+void slcan_serial_stats_reset(void);
 
 static void slcan_ack(char* buf);
 static void slcan_nack(char* buf);
 
-static char hex_digit(const uint8_t b)
-{
-    static const char* hex_tbl = "0123456789abcdef";
-    return hex_tbl[b & 0x0f];
-}
+/* Output not fitting in the line buffer is streamed by slcan_spin() before
+ * the command response is sent. */
+static void (*slcan_stream)(void* arg) = NULL;
 
-static void hex_write(char** p, const uint8_t* data, uint8_t len)
-{
-    unsigned int i;
-    for (i = 0; i < len; i++) {
-        *(*p)++ = hex_digit(data[i] >> 4);
-        *(*p)++ = hex_digit(data[i]);
-    }
-}
+/* reception of the command line being decoded [us] */
+static uint32_t slcan_line_time;
 
-static uint8_t hex_val(char c)
-{
-    if (c >= 'A' && c <= 'F') {
-        return c - 'A' + 0xA;
-    } else if (c >= 'a' && c <= 'f') {
-        return c - 'a' + 0xa;
-    } else {
-        return (c - '0') & 0xf;
-    }
-}
+static uint32_t slcan_nacks = 0;
 
-static uint32_t hex_to_u32(const char* str, uint8_t len)
+static RAMFUNC void slcan_timestamp_write(char** p, const struct can_frame_s* f, unsigned int timestamp)
 {
-    uint32_t val = 0;
-    unsigned int i;
-    for (i = 0; i < len; i++) {
-        val = (val << 4) | hex_val(str[i]);
+    if (timestamp == SLCAN_TIMESTAMP_MS) {
+        hex_encode_u32(*p, f->timestamp / 1000, 4);
+        *p += 4;
+    } else if (timestamp == SLCAN_TIMESTAMP_US) {
+        hex_encode_u32(*p, f->timestamp, 8);
+        *p += 8;
     }
-    return val;
 }
 
-static uint8_t hex_to_u8(const char* str)
+/* In-band events are sent as 'E', two hex digits event type, payload.
+ * SLCAN hosts ignore lines with unknown type characters. */
+static size_t slcan_event_to_ascii(char* buf, const struct can_frame_s* f, unsigned int timestamp)
 {
-    uint8_t val;
-    val = hex_val(*str++);
-    val = (val << 4) | hex_val(*str);
-    return val;
-}
+    char* p = buf;
+    uint8_t type = f->id;
 
-void hex_to_u8_array(const char* str, uint8_t* buf, size_t len)
-{
-    while (len-- > 0) {
-        *buf++ = hex_to_u8(str);
-        str += 2;
-    }
+    *p++ = 'E';
+    hex_write(&p, &type, 1);
+    hex_write(&p, f->data, f->length);
+    slcan_timestamp_write(&p, f, timestamp);
+
+    *p++ = '\r';
+    *p = 0;
+
+    return (size_t)(p - buf);
 }
 
-size_t slcan_frame_to_ascii(char* buf, const struct can_frame_s* f, bool timestamp)
+RAMFUNC size_t slcan_frame_to_ascii(char* buf, const struct can_frame_s* f, unsigned int timestamp)
 {
     char* p = buf;
     uint32_t id = f->id;
 
+    if (f->event) {
+        return slcan_event_to_ascii(buf, f, timestamp);
+    }
+
     // type
     if (f->remote) {
         if (f->extended) {
@@ -89,15 +96,11 @@ size_t slcan_frame_to_ascii(char* buf, const struct can_frame_s* f, bool timesta
 
     // ID
     if (f->extended) {
-        int i;
-        for (i = 3; i >= 0; i--) {
-            uint8_t b = id >> (8 * i);
-            hex_write(&p, &b, 1);
-        }
+        hex_encode_u32(p, id, 8);
+        p += 8;
     } else {
-        *p++ = hex_digit(id >> 8);
-        *p++ = hex_digit(id >> 4);
-        *p++ = hex_digit(id);
+        hex_encode_u32(p, id, 3);
+        p += 3;
     }
 
     // DLC
@@ -108,12 +111,7 @@ size_t slcan_frame_to_ascii(char* buf, const struct can_frame_s* f, bool timesta
         hex_write(&p, f->data, f->length);
     }
 
-    // timestamp
-    if (timestamp) {
-        uint16_t t = f->timestamp;
-        uint8_t b[2] = {t >> 8, t};
-        hex_write(&p, b, 2);
-    }
+    slcan_timestamp_write(&p, f, timestamp);
 
     *p++ = '\r';
     *p = 0;
@@ -121,54 +119,112 @@ size_t slcan_frame_to_ascii(char* buf, const struct can_frame_s* f, bool timesta
     return (size_t)(p - buf);
 }
 
+/* Sequence numbers on the receive stream, off by default
+ * Records are numbered here, as they leave the receive queue, the records
+ * have no room to carry a number from reception. The queue keeps the order
+ * of reception and the overflow record counts the records dropped before
+ * it, it advances the number by that count, so the numbers are those of
+ * the order of reception. */
+static bool slcan_sequence = false;
+static uint16_t slcan_sequence_next = 0;
+static uint16_t slcan_sequence_last = 0;
+
+/* timestamp format of the receive stream, set by 'Z' */
+static unsigned int slcan_timestamp = SLCAN_TIMESTAMP_OFF;
+
+RAMFUNC size_t slcan_record_to_ascii(char* buf, const struct can_frame_s* f)
+{
+    size_t len = slcan_frame_to_ascii(buf, f, slcan_timestamp);
+    uint16_t seq;
+    if (f->event && f->id == CAN_EVENT_HOST_OUTAGE) {
+        // created on the output side, repeats the number of the record before
+        seq = slcan_sequence_last;
+    } else {
+        if (f->event && f->id == CAN_EVENT_RX_OVERFLOW) {
+            uint32_t dropped = ((uint32_t)f->data[0] << 24) | ((uint32_t)f->data[1] << 16)
+                | ((uint32_t)f->data[2] << 8) | f->data[3];
+            slcan_sequence_next += dropped;
+        }
+        seq = slcan_sequence_next++;
+        slcan_sequence_last = seq;
+    }
+    if (slcan_sequence) {
+        char* p = buf + len - 1; // overwrite CR
+        hex_encode_u32(p, seq, 4);
+        p += 4;
+        *p++ = '\r';
+        *p = 0;
+        len = (size_t)(p - buf);
+    }
+    return len;
+}
+
 #define SLC_STD_ID_LEN 3
 #define SLC_EXT_ID_LEN 8
 
-void slcan_send_frame(char* line)
+RAMFUNC bool slcan_parse_frame(const char* line, struct can_frame_s* f)
 {
-    char* out = line;
-    uint8_t data[8];
-    uint8_t len;
-    uint32_t id;
-    bool remote = false;
-    bool extended = false;
+    size_t id_len = SLC_STD_ID_LEN;
+    uint32_t id_max = 0x7ff;
+
+    f->timestamp = 0;
+    f->remote = 0;
+    f->extended = 0;
+    f->event = 0;
 
     switch (*line++) {
         case 'r':
-            remote = true;
+            f->remote = 1;
             /* fallthrought */
         case 't':
-            id = hex_to_u32(line, SLC_STD_ID_LEN);
-            line += SLC_STD_ID_LEN;
             break;
         case 'R':
-            remote = true;
+            f->remote = 1;
             /* fallthrought */
         case 'T':
-            extended = true;
-            id = hex_to_u32(line, SLC_EXT_ID_LEN);
-            line += SLC_EXT_ID_LEN;
+            f->extended = 1;
+            id_len = SLC_EXT_ID_LEN;
+            id_max = 0x1fffffff;
             break;
         default:
-            slcan_nack(out);
-            return;
+            return false;
     };
 
-    len = hex_val(*line++);
+    size_t n = strcspn(line, "\r");
+    uint32_t id;
+    uint32_t len;
+    // the digits are validated while they are decoded
+    if (n < id_len + 1 || !hex_decode_u32(line, id_len, &id) || !hex_decode_u32(line + id_len, 1, &len)) {
+        return false;
+    }
+    if (id > id_max || len > 8) {
+        return false;
+    }
+    f->id = id;
+    f->length = len;
+    line += id_len + 1;
 
-    if (len > 8) {
-        slcan_nack(out);
-        return;
+    size_t data_len = f->remote ? 0 : 2 * len;
+    if (n != id_len + 1 + data_len) {
+        return false;
     }
+    return hex_decode(f->data, line, data_len / 2);
+}
+
+RAMFUNC void slcan_send_frame(char* line)
+{
+    struct can_frame_s f;
 
-    if (!remote) {
-        hex_to_u8_array(line, data, len);
+    if (!slcan_parse_frame(line, &f)) {
+        slcan_nack(line);
+        return;
     }
 
-    if (can_send(id, extended, remote, data, len)) {
-        slcan_ack(out);
+    if (can_send_timed(f.id, f.extended, f.remote, f.data, f.length, slcan_line_time)) {
+        latency_add(LATENCY_TX_MAILBOX, slcan_line_time);
+        slcan_ack(line);
     } else {
-        slcan_nack(out);
+        slcan_nack(line);
     }
 }
 
@@ -198,6 +254,777 @@ static void slcan_open(char* line, int mode)
     }
 }
 
+/*
+ * Periodic message monitor
+ *  Dtiii[pppppppp]       watch standard ID with period in us, learn if omitted
+ *  DTiiiiiiii[pppppppp]  watch extended ID
+ *  Dsn                   statistics of entry n: ID, period, interval count,
+ *                        min, mean, max, missed deadlines, jitter histogram
+ *  Dr                    reset statistics
+ *  Dc                    clear all watched IDs
+ */
+static void slcan_monitor(char* line)
+{
+    char* p = line + 2;
+    size_t len = strcspn(p, "\r");
+    size_t id_len = SLC_STD_ID_LEN;
+    uint32_t id, period = 0, n;
+    bool extended = false;
+    struct period_monitor_entry_s e;
+    unsigned int i;
+
+    switch (line[1]) {
+        case 'T':
+            extended = true;
+            id_len = SLC_EXT_ID_LEN;
+            /* fallthrough */
+        case 't':
+            if ((len != id_len && len != id_len + 8) || !hex_decode_u32(p, id_len, &id)) {
+                break;
+            }
+            if (len > id_len && !hex_decode_u32(p + id_len, 8, &period)) {
+                break;
+            }
+            if (can_monitor_watch(id, extended, period)) {
+                slcan_ack(line);
+                return;
+            }
+            break;
+        case 's':
+            if (len != 1 || !hex_decode_u32(p, 1, &n) || !can_monitor_get(n, &e)) {
+                break;
+            }
+            p = line;
+            if (e.extended) {
+                *p++ = 'T';
+                hex_write_u32(&p, e.id);
+            } else {
+                *p++ = 't';
+                *p++ = hex_digit(e.id >> 8);
+                *p++ = hex_digit(e.id >> 4);
+                *p++ = hex_digit(e.id);
+            }
+            hex_write_u32(&p, e.period);
+            hex_write_u32(&p, e.count);
+            hex_write_u32(&p, e.count > 0 ? e.min : 0);
+            hex_write_u32(&p, period_monitor_mean(&e));
+            hex_write_u32(&p, e.max);
+            hex_write_u32(&p, e.missed);
+            for (i = 0; i < PERIOD_MONITOR_HIST_BINS; i++) {
+                uint8_t b[2] = {e.hist[i] >> 8, e.hist[i]};
+                hex_write(&p, b, 2);
+            }
+            slcan_ack(p);
+            return;
+        case 'r':
+            can_monitor_reset();
+            slcan_ack(line);
+            return;
+        case 'c':
+            can_monitor_clear();
+            slcan_ack(line);
+            return;
+    }
+    slcan_nack(line);
+}
+
+static unsigned int capture_pre = CAPTURE_SIZE / 2;
+static unsigned int capture_post = CAPTURE_SIZE / 2 - 1;
+
+static void slcan_capture_dump(void* arg)
+{
+    static char buf[SLCAN_MAX_FRAME_LEN + 1];
+    struct can_frame_s f;
+    unsigned int i;
+    // ms timestamps unless the stream has us ones
+    unsigned int format = slcan_timestamp == SLCAN_TIMESTAMP_US ? SLCAN_TIMESTAMP_US : SLCAN_TIMESTAMP_MS;
+    buf[0] = 'K';
+    for (i = 0; can_capture_get(i, &f); i++) {
+        size_t len = slcan_frame_to_ascii(&buf[1], &f, format);
+        slcan_serial_write(arg, buf, len + 1);
+    }
+}
+
+/*
+ * Pre/post trigger capture
+ *  Kwnnnnmmmm                     keep n frames before and m after the trigger
+ *  Ktiiimmm[dd..mm..]             arm on standard ID iii with mask mmm and
+ *                                 optionally payload bytes dd with masks mm
+ *  KTiiiiiiiimmmmmmmm[dd..mm..]   arm on extended ID
+ *  Ke                             arm on error frame
+ *  Kb                             arm on bus-off
+ *  Ks                             state (0 idle, 1 armed, 2 triggered, 3 done)
+ *                                 and number of captured frames
+ *  Kf                             stop recording
+ *  Kd                             stop recording and dump the capture, one
+ *                                 'K' prefixed frame with timestamp per line
+ */
+static void slcan_capture(char* line)
+{
+    char* p = line + 2;
+    size_t len = strcspn(p, "\r");
+    size_t id_len = SLC_STD_ID_LEN;
+    struct capture_trigger_s t = {.type = CAPTURE_TRIGGER_FRAME};
+    uint32_t pre, post, id, mask;
+    unsigned int count;
+    uint8_t state;
+
+    switch (line[1]) {
+        case 'w':
+            if (len != 8 || !hex_decode_u32(p, 4, &pre) || !hex_decode_u32(p + 4, 4, &post)
+                || pre + post + 1 > CAPTURE_SIZE) {
+                break;
+            }
+            capture_pre = pre;
+            capture_post = post;
+            slcan_ack(line);
+            return;
+        case 'T':
+            t.extended = true;
+            id_len = SLC_EXT_ID_LEN;
+            /* fallthrough */
+        case 't':
+            if (len < 2 * id_len || (len - 2 * id_len) % 4 != 0 || len - 2 * id_len > 4 * 8) {
+                break;
+            }
+            if (!hex_decode_u32(p, id_len, &id) || !hex_decode_u32(p + id_len, id_len, &mask)) {
+                break;
+            }
+            t.id = id;
+            t.mask = mask;
+            p += 2 * id_len;
+            t.length = (len - 2 * id_len) / 4;
+            if (!hex_decode(t.data, p, t.length) || !hex_decode(t.data_mask, p + 2 * t.length, t.length)) {
+                break;
+            }
+            if (can_capture_arm(&t, capture_pre, capture_post)) {
+                slcan_ack(line);
+                return;
+            }
+            break;
+        case 'e':
+            t.type = CAPTURE_TRIGGER_ERROR;
+            if (can_capture_arm(&t, capture_pre, capture_post)) {
+                slcan_ack(line);
+                return;
+            }
+            break;
+        case 'b':
+            t.type = CAPTURE_TRIGGER_BUS_OFF;
+            if (can_capture_arm(&t, capture_pre, capture_post)) {
+                slcan_ack(line);
+                return;
+            }
+            break;
+        case 's':
+            state = can_capture_state(&count);
+            p = line;
+            *p++ = hex_digit(state);
+            *p++ = hex_digit(count >> 12);
+            *p++ = hex_digit(count >> 8);
+            *p++ = hex_digit(count >> 4);
+            *p++ = hex_digit(count);
+            slcan_ack(p);
+            return;
+        case 'd':
+            slcan_stream = slcan_capture_dump;
+            /* fallthrough */
+        case 'f':
+            can_capture_freeze();
+            slcan_ack(line);
+            return;
+    }
+    slcan_nack(line);
+}
+
+static void slcan_replay_errors(void* arg)
+{
+    char buf[sizeof("Y00000000\r")];
+    unsigned int i;
+    int32_t error;
+    for (i = 0; can_replay_error(i, &error); i++) {
+        char* p = buf;
+        *p++ = 'Y';
+        hex_write_u32(&p, error);
+        *p++ = '\r';
+        slcan_serial_write(arg, buf, p - buf);
+    }
+}
+
+/*
+ * Trace replay
+ *  Yc                  clear the trace
+ *  Yaoooooooo<frame>   append a frame in t, T, r or R format, sent at offset
+ *                      o [us] from the start of the trace, also during a
+ *                      single run in place of the oldest sent frame
+ *  Ydpppppppp          loop period [us], 0 to derive it from the offsets
+ *  Ys[ssss[nnnn]]      start at s percent of the recorded speed (default 100)
+ *                      for n runs (default 1, 0 loops forever)
+ *  Yx                  stop
+ *  Yq                  state (0 idle, 1 running), number of frames, next
+ *                      frame and current run
+ *  Ye                  start of frame error of each frame in the last run
+ *                      [us], one 'Y' prefixed line per frame
+ */
+static void slcan_replay(char* line)
+{
+    char* p = line + 2;
+    size_t len = strcspn(p, "\r");
+    struct can_frame_s f;
+    uint32_t val, speed = 100, loops = 1;
+    unsigned int count, next, loop;
+    uint8_t state;
+
+    switch (line[1]) {
+        case 'c':
+            can_replay_clear();
+            slcan_ack(line);
+            return;
+        case 'a':
+            if (len < 8 + 1 || !hex_decode_u32(p, 8, &val) || !slcan_parse_frame(p + 8, &f)) {
+                break;
+            }
+            if (can_replay_add(&f, val)) {
+                slcan_ack(line);
+                return;
+            }
+            break;
+        case 'd':
+            if (len != 8 || !hex_decode_u32(p, 8, &val)) {
+                break;
+            }
+            can_replay_set_duration(val);
+            slcan_ack(line);
+            return;
+        case 's':
+            if (len != 0 && len != 4 && len != 8) {
+                break;
+            }
+            if (len >= 4 && !hex_decode_u32(p, 4, &speed)) {
+                break;
+            }
+            if (len == 8 && !hex_decode_u32(p + 4, 4, &loops)) {
+                break;
+            }
+            if (can_replay_start(speed, loops)) {
+                slcan_ack(line);
+                return;
+            }
+            break;
+        case 'x':
+            can_replay_stop();
+            slcan_ack(line);
+            return;
+        case 'q':
+            state = can_replay_state(&count, &next, &loop);
+            p = line;
+            *p++ = hex_digit(state);
+            *p++ = hex_digit(count >> 12);
+            *p++ = hex_digit(count >> 8);
+            *p++ = hex_digit(count >> 4);
+            *p++ = hex_digit(count);
+            *p++ = hex_digit(next >> 12);
+            *p++ = hex_digit(next >> 8);
+            *p++ = hex_digit(next >> 4);
+            *p++ = hex_digit(next);
+            hex_write_u32(&p, loop);
+            slcan_ack(p);
+            return;
+        case 'e':
+            slcan_stream = slcan_replay_errors;
+            slcan_ack(line);
+            return;
+    }
+    slcan_nack(line);
+}
+
+static struct generator_config_s generator_config = {
+    .id_mode = GENERATOR_ID_FIXED,
+    .id_min = 0x7ff,
+    .id_max = 0x7ff,
+    .dlc_min = 8,
+    .dlc_max = 8,
+    .data_mode = GENERATOR_DATA_COUNTER,
+};
+
+/*
+ * Traffic generator
+ *  Gfiii, GFiiiiiiii                   fixed standard or extended ID
+ *  Giiiijjj, GIiiiiiiiijjjjjjjj        IDs i to j, incrementing
+ *  Griiijjj, GRiiiiiiiijjjjjjjj        IDs i to j, random
+ *  Gdnm                                DLC uniform in n to m
+ *  Gpc, Gpr, Gpfdddddddddddddddd       counter, random or fixed payload
+ *  Glpp                                start at p percent bus load,
+ *                                      100 keeps the mailboxes full
+ *  Ghrrrrrrrr                          start at r frames/s
+ *  Gx                                  stop
+ *  Gq                                  running, frames sent, achieved load
+ *                                      [0.1 %], mailbox timeouts, failed
+ *                                      transmissions and bus errors
+ */
+static void slcan_generator(char* line)
+{
+    char* p = line + 2;
+    size_t len = strcspn(p, "\r");
+    size_t id_len = SLC_STD_ID_LEN;
+    bool extended = false;
+    uint32_t lo, hi;
+    uint8_t data[8];
+    struct can_generator_stats_s s;
+
+    switch (line[1]) {
+        case 'F':
+        case 'I':
+        case 'R':
+            extended = true;
+            id_len = SLC_EXT_ID_LEN;
+            /* fallthrough */
+        case 'f':
+        case 'i':
+        case 'r':
+            if (line[1] == 'f' || line[1] == 'F') {
+                if (len != id_len || !hex_decode_u32(p, id_len, &lo)) {
+                    break;
+                }
+                generator_config.id_mode = GENERATOR_ID_FIXED;
+                generator_config.id_min = lo;
+                generator_config.id_max = lo;
+            } else {
+                if (len != 2 * id_len || !hex_decode_u32(p, id_len, &lo) || !hex_decode_u32(p + id_len, id_len, &hi)) {
+                    break;
+                }
+                generator_config.id_mode = (line[1] == 'i' || line[1] == 'I') ? GENERATOR_ID_INCREMENT : GENERATOR_ID_RANDOM;
+                generator_config.id_min = lo;
+                generator_config.id_max = hi;
+            }
+            generator_config.extended = extended;
+            slcan_ack(line);
+            return;
+        case 'd':
+            if (len != 2 || !hex_decode_u32(p, 1, &lo) || !hex_decode_u32(p + 1, 1, &hi) || hi > 8 || lo > hi) {
+                break;
+            }
+            generator_config.dlc_min = lo;
+            generator_config.dlc_max = hi;
+            slcan_ack(line);
+            return;
+        case 'p':
+            if (len == 1 && p[0] == 'c') {
+                generator_config.data_mode = GENERATOR_DATA_COUNTER;
+            } else if (len == 1 && p[0] == 'r') {
+                generator_config.data_mode = GENERATOR_DATA_RANDOM;
+            } else if (len == 1 + 2 * 8 && p[0] == 'f' && hex_decode(data, p + 1, 8)) {
+                generator_config.data_mode = GENERATOR_DATA_FIXED;
+                memcpy(generator_config.data, data, 8);
+            } else {
+                break;
+            }
+            slcan_ack(line);
+            return;
+        case 'l':
+            if (len != 2 || !hex_decode_u32(p, 2, &lo) || lo == 0 || lo > 100) {
+                break;
+            }
+            generator_config.rate = 0;
+            generator_config.load = lo;
+            if (can_generator_start(&generator_config)) {
+                slcan_ack(line);
+                return;
+            }
+            break;
+        case 'h':
+            if (len != 8 || !hex_decode_u32(p, 8, &lo) || lo == 0) {
+                break;
+            }
+            generator_config.rate = lo;
+            generator_config.load = 0;
+            if (can_generator_start(&generator_config)) {
+                slcan_ack(line);
+                return;
+            }
+            break;
+        case 'x':
+            can_generator_stop();
+            slcan_ack(line);
+            return;
+        case 'q':
+            can_generator_stats(&s);
+            p = line;
+            *p++ = s.running ? '1' : '0';
+            hex_write_u32(&p, s.sent);
+            *p++ = hex_digit(s.load >> 12);
+            *p++ = hex_digit(s.load >> 8);
+            *p++ = hex_digit(s.load >> 4);
+            *p++ = hex_digit(s.load);
+            hex_write_u32(&p, s.timeouts);
+            hex_write_u32(&p, s.failed);
+            hex_write_u32(&p, s.bus_errors);
+            slcan_ack(p);
+            return;
+    }
+    slcan_nack(line);
+}
+
+static void slcan_bench_histogram(void* arg)
+{
+    struct can_bench_s b;
+    char buf[sizeof("B00000000\r")];
+    unsigned int i;
+    can_bench_get(&b);
+    for (i = 0; i < HISTOGRAM_BINS; i++) {
+        char* p = buf;
+        *p++ = 'B';
+        hex_write_u32(&p, b.latency.bins[i]);
+        *p++ = '\r';
+        slcan_serial_write(arg, buf, p - buf);
+    }
+}
+
+/*
+ * Loop back self-benchmark
+ *  Brdddd  send frames through the transmit and receive paths in silent loop
+ *          back mode for d ms, at most CAN_BENCH_MAX_DURATION as the
+ *          commands wait meanwhile, the channel must be closed. Returns frames
+ *          sent and received, received frames/s, CPU cycles per frame,
+ *          receive queue high-water mark and min, mean and max latency [us]
+ *  Bh      latency histogram of the last run, one 'B' prefixed line per
+ *          bin, see histogram.h
+ */
+static void slcan_bench(char* line)
+{
+    char* p = line + 2;
+    size_t len = strcspn(p, "\r");
+    struct can_bench_s b;
+    uint32_t val;
+
+    switch (line[1]) {
+        case 'r':
+            if (len != 4 || !hex_decode_u32(p, 4, &val) || val == 0 || val > CAN_BENCH_MAX_DURATION
+                || !can_bench_run(val, &b)) {
+                break;
+            }
+            p = line;
+            hex_write_u32(&p, b.sent);
+            hex_write_u32(&p, b.received);
+            val = b.elapsed > 0 ? (uint64_t)b.received * 1000000 / b.elapsed : 0;
+            hex_write_u32(&p, val);
+            val = b.received > 0 ? b.busy / b.received : 0;
+            hex_write_u32(&p, val);
+            *p++ = hex_digit(b.queue_high_water >> 12);
+            *p++ = hex_digit(b.queue_high_water >> 8);
+            *p++ = hex_digit(b.queue_high_water >> 4);
+            *p++ = hex_digit(b.queue_high_water);
+            hex_write_u32(&p, b.latency.count > 0 ? b.latency.min : 0);
+            hex_write_u32(&p, histogram_mean(&b.latency));
+            hex_write_u32(&p, b.latency.max);
+            slcan_ack(p);
+            return;
+        case 'h':
+            slcan_stream = slcan_bench_histogram;
+            slcan_ack(line);
+            return;
+    }
+    slcan_nack(line);
+}
+
+static void slcan_latency_dump(void* arg)
+{
+    struct histogram_s h;
+    char buf[2 + 4 * 8 + HISTOGRAM_BINS * 8 + 1];
+    unsigned int i, j;
+    for (i = 0; i < LATENCY_STAGES; i++) {
+        char* p = buf;
+        latency_get(i, &h);
+        *p++ = 'H';
+        *p++ = hex_digit(i);
+        hex_write_u32(&p, h.count);
+        hex_write_u32(&p, h.count > 0 ? h.min : 0);
+        hex_write_u32(&p, histogram_mean(&h));
+        hex_write_u32(&p, h.max);
+        for (j = 0; j < HISTOGRAM_BINS; j++) {
+            hex_write_u32(&p, h.bins[j]);
+        }
+        *p++ = '\r';
+        slcan_serial_write(arg, buf, p - buf);
+    }
+}
+
+/*
+ * Per-stage latency histograms, see latency.h
+ *  Hd  one line per stage: 'H', stage, count, min, mean and max [us] and the
+ *      histogram bins, followed by the ACK
+ *  Hr  reset
+ */
+static void slcan_latency(char* line)
+{
+    switch (line[1]) {
+        case 'd':
+            slcan_stream = slcan_latency_dump;
+            slcan_ack(line);
+            return;
+        case 'r':
+            latency_reset();
+            slcan_ack(line);
+            return;
+    }
+    slcan_nack(line);
+}
+
+static void slcan_threads(void* arg)
+{
+    struct cpu_thread_info_s t;
+    char buf[1 + 4 + 32 + 1];
+    unsigned int i;
+    for (i = 0; cpu_thread_info(i, &t); i++) {
+        char* p = buf;
+        *p++ = 'I';
+        *p++ = hex_digit(t.stack_unused >> 12);
+        *p++ = hex_digit(t.stack_unused >> 8);
+        *p++ = hex_digit(t.stack_unused >> 4);
+        *p++ = hex_digit(t.stack_unused);
+        if (t.name != NULL) {
+            size_t len = strnlen(t.name, 32);
+            memcpy(p, t.name, len);
+            p += len;
+        }
+        *p++ = '\r';
+        slcan_serial_write(arg, buf, p - buf);
+    }
+}
+
+/*
+ * Runtime statistics
+ *  Is          frames received and sent, bytes written to USB, NACKs,
+ *              receive queue drops, controller FIFO overruns, USB write
+ *              timeouts, bus errors, receive queue and pool high-water marks,
+ *              receive queue size
+ *  It          one line per thread: 'I', never used stack [bytes], name
+ *  Ir          reset the counters and high-water marks
+ *  Ipnnnn      send an in-band status record every n ms, 0 to disable
+ */
+static void slcan_stats(char* line)
+{
+    char* p = line + 2;
+    size_t len = strcspn(p, "\r");
+    struct can_stats_s s;
+    uint32_t written, timeouts, period;
+
+    switch (line[1]) {
+        case 's':
+            can_stats_get(&s);
+            slcan_serial_stats(&written, &timeouts);
+            p = line;
+            hex_write_u32(&p, s.rx_frames);
+            hex_write_u32(&p, s.tx_frames);
+            hex_write_u32(&p, written);
+            hex_write_u32(&p, slcan_nacks);
+            hex_write_u32(&p, s.rx_dropped);
+            hex_write_u32(&p, s.fifo_overruns);
+            hex_write_u32(&p, timeouts);
+            hex_write_u32(&p, s.bus_errors);
+            *p++ = hex_digit(s.queue_high_water >> 12);
+            *p++ = hex_digit(s.queue_high_water >> 8);
+            *p++ = hex_digit(s.queue_high_water >> 4);
+            *p++ = hex_digit(s.queue_high_water);
+            *p++ = hex_digit(s.pool_high_water >> 12);
+            *p++ = hex_digit(s.pool_high_water >> 8);
+            *p++ = hex_digit(s.pool_high_water >> 4);
+            *p++ = hex_digit(s.pool_high_water);
+            *p++ = hex_digit(s.queue_size >> 12);
+            *p++ = hex_digit(s.queue_size >> 8);
+            *p++ = hex_digit(s.queue_size >> 4);
+            *p++ = hex_digit(s.queue_size);
+            slcan_ack(p);
+            return;
+        case 't':
+            slcan_stream = slcan_threads;
+            slcan_ack(line);
+            return;
+        case 'r':
+            can_stats_reset();
+            slcan_serial_stats_reset();
+            slcan_nacks = 0;
+            slcan_ack(line);
+            return;
+        case 'p':
+            if (len != 4 || !hex_decode_u32(p, 4, &period)) {
+                break;
+            }
+            can_status_set_period(period);
+            slcan_ack(line);
+            return;
+    }
+    slcan_nack(line);
+}
+
+static void slcan_cpu_load_dump(void* arg)
+{
+    struct cpu_thread_info_s t;
+    struct cpu_isr_info_s isr;
+    char buf[2 + 4 + 32 + 1];
+    unsigned int i;
+    for (i = 0; cpu_thread_info(i, &t); i++) {
+        char* p = buf;
+        *p++ = 'U';
+        *p++ = 't';
+        *p++ = hex_digit(t.load >> 12);
+        *p++ = hex_digit(t.load >> 8);
+        *p++ = hex_digit(t.load >> 4);
+        *p++ = hex_digit(t.load);
+        if (t.name != NULL) {
+            size_t len = strnlen(t.name, 32);
+            memcpy(p, t.name, len);
+            p += len;
+        }
+        *p++ = '\r';
+        slcan_serial_write(arg, buf, p - buf);
+    }
+    for (i = 0; cpu_isr_info(i, &isr); i++) {
+        char* p = buf;
+        *p++ = 'U';
+        *p++ = 'i';
+        *p++ = hex_digit(isr.irq >> 4);
+        *p++ = hex_digit(isr.irq);
+        *p++ = hex_digit(isr.load >> 12);
+        *p++ = hex_digit(isr.load >> 8);
+        *p++ = hex_digit(isr.load >> 4);
+        *p++ = hex_digit(isr.load);
+        *p++ = '\r';
+        slcan_serial_write(arg, buf, p - buf);
+    }
+}
+
+/*
+ * CPU load since the last reset [0.1 %]
+ *  Ud  one line per thread: 'Ut', load, name, then one line per interrupt:
+ *      'Ui', interrupt number, load, followed by the ACK
+ *  Ur  reset
+ */
+static void slcan_cpu_load(char* line)
+{
+    switch (line[1]) {
+        case 'd':
+            slcan_stream = slcan_cpu_load_dump;
+            slcan_ack(line);
+            return;
+        case 'r':
+            cpu_load_reset();
+            slcan_ack(line);
+            return;
+    }
+    slcan_nack(line);
+}
+
+static void slcan_trace_dump(void* arg)
+{
+    char buf[1 + 8 + 1];
+    char* p = buf;
+    *p++ = 'J';
+    hex_write_u32(&p, trace_dump_size());
+    *p++ = '\r';
+    slcan_serial_write(arg, buf, p - buf);
+    trace_dump(slcan_serial_write, arg);
+}
+
+/*
+ * Binary event trace, see trace.h
+ *  Js  start recording
+ *  Jx  stop recording
+ *  Jd  stop recording after the next dropped frame
+ *  JD  keep recording after dropped frames
+ *  Jb  stop recording and dump: 'J' and the dump size in bytes, the binary
+ *      dump, followed by the ACK
+ */
+static void slcan_trace(char* line)
+{
+    switch (line[1]) {
+        case 's':
+            trace_start();
+            slcan_ack(line);
+            return;
+        case 'x':
+            trace_stop();
+            slcan_ack(line);
+            return;
+        case 'd':
+        case 'D':
+            trace_stop_on_drop(line[1] == 'd');
+            slcan_ack(line);
+            return;
+        case 'b':
+            trace_stop();
+            slcan_stream = slcan_trace_dump;
+            slcan_ack(line);
+            return;
+    }
+    slcan_nack(line);
+}
+
+/*
+ * Timestamps on the receive stream
+ *  Z0  none
+ *  Z1  16 bit ms timestamp, 4 hex digits
+ *  Z2  us timestamp modulo 65536000, 8 hex digits (proprietary)
+ */
+static void slcan_set_timestamp(char* line)
+{
+    if (line[1] >= '0' && line[1] <= '2' && strcspn(&line[2], "\r") == 0) {
+        slcan_timestamp = line[1] - '0';
+        slcan_ack(line);
+        return;
+    }
+    slcan_nack(line);
+}
+
+/*
+ * Sequence numbers
+ *  Q1  append the 16 bit sequence number to every received frame and event
+ *  Q0  plain SLCAN records
+ */
+static void slcan_set_sequence(char* line)
+{
+    if ((line[1] == '0' || line[1] == '1') && strcspn(&line[2], "\r") == 0) {
+        slcan_sequence = line[1] == '1';
+        slcan_ack(line);
+        return;
+    }
+    slcan_nack(line);
+}
+
+/*
+ * Transmit credits, see can_tx_credit_enable()
+ *  X1  send E07 credit records, the host keeps the number of frames sent
+ *      since X1, minus the NACKed ones, below the last granted total
+ *  X0  no credit records
+ */
+static void slcan_tx_credit(char* line)
+{
+    if ((line[1] == '0' || line[1] == '1') && strcspn(&line[2], "\r") == 0) {
+        can_tx_credit_enable(line[1] == '1');
+        slcan_ack(line);
+        return;
+    }
+    slcan_nack(line);
+}
+
+static void slcan_usb_sof(char* line)
+{
+    struct usb_sof_s s;
+    if (strcspn(&line[1], "\r") != 0 || !usb_sof_get(&s)) {
+        slcan_nack(line);
+        return;
+    }
+    char* p = line + 1;
+    *p++ = hex_digit(s.frame >> 8);
+    *p++ = hex_digit(s.frame >> 4);
+    *p++ = hex_digit(s.frame);
+    hex_write_u32(&p, s.time >> 32);
+    hex_write_u32(&p, s.time);
+    hex_write_u32(&p, s.now >> 32);
+    hex_write_u32(&p, s.now);
+    slcan_ack(p);
+}
+
 static void slcan_close(char* line)
 {
     can_close();
@@ -214,6 +1041,7 @@ static void slcan_ack(char* buf)
 /** wirtes a NULL terminated NACK response */
 static void slcan_nack(char* buf)
 {
+    slcan_nacks++;
     *buf++ = '\a'; // BELL
     *buf = 0;
 }
@@ -260,12 +1088,14 @@ void slcan_decode_line(char* line)
             line[2] = '0';
             slcan_ack(line);
             break;
+        case 'Z': // timestamp format, Zx[CR]
+            slcan_set_timestamp(line);
+            break;
         case '\0': // Empty line, requires an ACK to be sent back
             slcan_ack(line);
             break;
         // 'N': // serial number
         // 'F': // read status byte
-        // 'Z': // timestamp on/off, Zx[CR]
         // 'm': // acceptance mask, mxxxxxxxx[CR]
         // 'M': // acceptance code, Mxxxxxxxx[CR]
 
@@ -278,29 +1108,88 @@ void slcan_decode_line(char* line)
             bus_power(false);
             slcan_ack(line);
             break;
+        case 'D': // periodic message monitor
+            slcan_monitor(line);
+            break;
+        case 'K': // pre/post trigger capture
+            slcan_capture(line);
+            break;
+        case 'Y': // trace replay
+            slcan_replay(line);
+            break;
+        case 'G': // traffic generator
+            slcan_generator(line);
+            break;
+        case 'B': // loop back self-benchmark
+            slcan_bench(line);
+            break;
+        case 'H': // latency histograms
+            slcan_latency(line);
+            break;
+        case 'I': // runtime statistics
+            slcan_stats(line);
+            break;
+        case 'U': // CPU load
+            slcan_cpu_load(line);
+            break;
+        case 'J': // binary event trace
+            slcan_trace(line);
+            break;
+        case 'Q': // sequence numbers
+            slcan_set_sequence(line);
+            break;
+        case 'X': // transmit credits
+            slcan_tx_credit(line);
+            break;
+        case 'W': // USB start of frame time
+            slcan_usb_sof(line);
+            break;
         default:
             slcan_nack(line);
             break;
     };
 }
 
-void slcan_spin(void* arg)
+bool slcan_spin(void* arg)
 {
     char* line = slcan_getline(arg);
-    if (line) {
-        slcan_decode_line(line);
-        slcan_serial_write(arg, line, strlen(line));
+    if (line == NULL) {
+        return false;
+    }
+    slcan_line_time = latency_now();
+    trace_event(TRACE_LINE, strlen(line));
+    slcan_decode_line(line);
+    /* the receive stream only gets its turn between command lines, so a
+     * dump and its ACK are written without frames in between */
+    if (slcan_stream != NULL) {
+        slcan_stream(arg);
+        slcan_stream = NULL;
     }
+    if (slcan_serial_write(arg, line, strlen(line)) > 0) {
+        latency_add(LATENCY_TX_ACK, slcan_line_time);
+    }
+    return true;
 }
 
-void slcan_rx_spin(void* arg)
+bool slcan_rx_spin(void* arg, unsigned int max)
 {
     struct can_frame_s* rxf;
-    while ((rxf = can_receive()) != NULL) {
-        static char txbuf[MAX_FRAME_LEN];
+    char* txbuf;
+    unsigned int n;
+    // frames stay queued while the host is away or the output is full
+    for (n = 0; n < max; n++) {
+        if (!slcan_host_ready(arg)
+            || (txbuf = slcan_serial_reserve(arg, SLCAN_MAX_FRAME_LEN)) == NULL
+            || (rxf = can_receive()) == NULL) {
+            return false;
+        }
         size_t len;
-        len = slcan_frame_to_ascii(txbuf, rxf, false);
+        uint32_t read = can_frame_time(rxf);
+        len = slcan_record_to_ascii(txbuf, rxf);
+        latency_add(LATENCY_RX_ENCODE, read);
+        trace_event(TRACE_ENCODE, len);
         can_frame_delete(rxf);
-        slcan_serial_write(arg, txbuf, len);
+        slcan_serial_commit(arg, len, read);
     }
+    return true;
 }
@@ -1,11 +1,36 @@
 #ifndef SLCAN_H
 #define SLCAN_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include "can_driver.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-void slcan_spin(void* arg);
+/* longest encoded frame, including us timestamp, sequence number and
+ * terminating NULL */
+#define SLCAN_MAX_FRAME_LEN (sizeof("T1111222281122334455667788" "03e7ffff" "0123\r") + 1)
+
+/* timestamp formats of slcan_frame_to_ascii() */
+enum {
+    SLCAN_TIMESTAMP_OFF,
+    SLCAN_TIMESTAMP_MS, // 4 hex digits [ms], wraps at 65536 ms
+    SLCAN_TIMESTAMP_US, // 8 hex digits [us], wraps at CAN_TIMESTAMP_WRAP
+};
+
+/* handles one command line, returns false if there is none */
+bool slcan_spin(void* arg);
+/* encodes up to max received frames while there is room for them, returns
+ * true if it stopped at max */
+bool slcan_rx_spin(void* arg, unsigned int max);
+size_t slcan_frame_to_ascii(char* buf, const struct can_frame_s* f, unsigned int timestamp);
+/* encodes a record of the receive stream, with the sequence number if enabled */
+size_t slcan_record_to_ascii(char* buf, const struct can_frame_s* f);
+/* parses a t, T, r or R frame, returns false if it is malformed, every
+ * field must be complete and hex and nothing may follow the data but CR */
+bool slcan_parse_frame(const char* line, struct can_frame_s* f);
 
 #ifdef __cplusplus
 }
@@ -1,74 +1,404 @@
 #include <ch.h>
 #include <hal.h>
 #include <stddef.h>
+#include <string.h>
+#include <timestamp/timestamp.h>
+#include <timestamp/timestamp_stm32.h>
 #include "can_driver.h"
 #include "slcan.h"
 #include "slcan_thread.h"
+#include "replay_thread.h"
+#include "generator_thread.h"
+#include "trace.h"
+#include "record_queue.h"
+#include "line_reader.h"
+#include "latency.h"
+
+/* I/O loop
+ * A single thread serves the host. It waits for USB input or output space,
+ * records in the CAN receive queue, a done transmit mailbox, the next
+ * deadline or the tick, then handles whatever is ready without blocking.
+ * Only command output that doesn't fit in the queues (dumps) is written
+ * synchronously.
+ */
+#define SLCAN_EVENT_USB EVENT_MASK(0)
+#define SLCAN_EVENT_CAN_RX EVENT_MASK(1)
+#define SLCAN_EVENT_CAN_TX EVENT_MASK(2)
+#define SLCAN_TICK_US 10000
+// command lines handled before the receive stream gets its turn again
+#define SLCAN_LINES_PER_PASS 8
+// received frames encoded before the command lines get their turn, bounds
+// the response latency under a heavy receive stream
+#define SLCAN_FRAMES_PER_PASS 16
+
+static event_listener_t usb_listener;
+
+/* Input is read a USB packet at a time and split into lines, the line is
+ * decoded in place and reused for the response. Transmit commands wait in
+ * the line reader until a mailbox is free, after SLCAN_TX_WAIT they are
+ * handed to can_send(), which fails them if the bus is stuck. */
+#define SLCAN_PACKET_SIZE 64
+#define SLCAN_TX_WAIT 100000 // [us]
+
+static struct {
+    struct line_reader_s reader;
+    char packet[SLCAN_PACKET_SIZE];
+    size_t pos;
+    size_t len;
+    char* line; // waiting for a transmit mailbox
+    timestamp_t since;
+} input;
+
+static void input_reset(void)
+{
+    line_reader_init(&input.reader);
+    input.pos = 0;
+    input.len = 0;
+    input.line = NULL;
+}
+
+static bool input_tx_blocked(const char* line)
+{
+    switch (line[0]) {
+        case 't':
+        case 'T':
+        case 'r':
+        case 'R':
+            return can_is_open() && !can_tx_ready();
+        default:
+            return false;
+    }
+}
 
 char* slcan_getline(void* arg)
 {
-    static char line_buffer[500];
-    static size_t pos = 0;
-    size_t i;
-    for (i = pos; i < sizeof(line_buffer); i++) {
-        int c = chnGetTimeout((BaseChannel*)arg, TIME_INFINITE);
-        if (c == STM_TIMEOUT) {
-            /* no more data, continue */
-            pos = i;
-            return NULL;
+    char* line = input.line;
+
+    if (line == NULL) {
+        while (line == NULL) {
+            if (input.pos == input.len) {
+                // take everything already received
+                input.len = chnReadTimeout((BaseChannel*)arg, (uint8_t*)input.packet, sizeof(input.packet), TIME_IMMEDIATE);
+                input.pos = 0;
+                if (input.len == 0) {
+                    return NULL;
+                }
+            }
+            input.pos += line_reader_feed(&input.reader, &input.packet[input.pos], input.len - input.pos, &line);
         }
-        if (c == '\n' || c == '\r' || c == '\0') {
-            /* line found */
-            line_buffer[i] = 0;
-            pos = 0;
-            led_set(STATUS_LED); // show USB activity
-            return line_buffer;
-        } else {
-            line_buffer[i] = c;
+        led_set(STATUS_LED); // show USB activity
+        input.line = line;
+        input.since = timestamp_get();
+    }
+    if (input_tx_blocked(line) && timestamp_duration_us(input.since, timestamp_get()) < SLCAN_TX_WAIT) {
+        return NULL;
+    }
+    input.line = NULL;
+    return line;
+}
+
+/* Output
+ * Records are encoded straight into the buffers of the USB output queue. A
+ * buffer is posted as one transfer when the next record doesn't fit or at
+ * the end of a pass of the loop, so records never straddle a transfer.
+ * Command responses go through the response queue, which is copied to the
+ * output before the receive stream gets its turn, so they go ahead of the
+ * frames waiting in the CAN receive queue. A pass encodes at most
+ * SLCAN_FRAMES_PER_PASS frames before the command lines are read.
+ */
+#define SLCAN_RESPONSE_QUEUE_SIZE 512
+#define SLCAN_RECORD_MAX 254
+#define SLCAN_WRITE_TIMEOUT 100000 // [us] without an output buffer
+
+#if SLCAN_RECORD_MAX > SERIAL_USB_BUFFERS_SIZE
+#error "a record must fit in an output buffer"
+#endif
+
+// frames in an output buffer, at the length of the shortest one
+#define SLCAN_BUFFER_FRAMES (SERIAL_USB_BUFFERS_SIZE / (sizeof("t1230\r") - 1))
+
+static uint8_t response_buf[SLCAN_RESPONSE_QUEUE_SIZE];
+static struct record_queue_s response_queue;
+
+// output buffer being filled
+static struct {
+    uint8_t* buf; // NULL if none is held
+    size_t len;
+    size_t size;
+    uint32_t start[SLCAN_BUFFER_FRAMES]; // of the frames in the buffer [us]
+    unsigned int frames;
+    bool stalled; // output waiting for a buffer
+    timestamp_t since; // start of the stall
+} writer;
+
+/* Host outage
+ * Entered when the output gets no buffer for SLCAN_WRITE_TIMEOUT because
+ * the host doesn't read or the USB link is down. Frames stay in the CAN
+ * receive queue meanwhile. On return the queued responses are written and
+ * a CAN_EVENT_HOST_OUTAGE record is sent before the backlog is drained.
+ * Buffers posted before the link went down are lost whole, records are
+ * never cut.
+ */
+static struct {
+    bool active;
+    bool unreported; // outage record not sent yet
+    ltimestamp_t start;
+    ltimestamp_t end;
+} outage;
+
+static uint32_t serial_written; // bytes
+static uint32_t serial_timeouts;
+
+/* The channel is the USB serial driver, the host is back when the link is
+ * up and it has read at least one buffer of the output queue. */
+static bool outage_over(SerialUSBDriver* sdu)
+{
+    chSysLock();
+    bool space = sdu->config->usbp->state == USB_ACTIVE && bqSpaceI(&sdu->obqueue) > 0;
+    chSysUnlock();
+    if (!space) {
+        return false;
+    }
+    outage.active = false;
+    outage.end = ltimestamp_get();
+    writer.stalled = false;
+    return true;
+}
+
+static void writer_stall(void)
+{
+    timestamp_t now = timestamp_get();
+    if (!writer.stalled) {
+        writer.stalled = true;
+        writer.since = now;
+    } else if (timestamp_duration_us(writer.since, now) >= SLCAN_WRITE_TIMEOUT) {
+        serial_timeouts++;
+        outage.active = true;
+        if (!outage.unreported) {
+            outage.start = ltimestamp_get();
+            outage.unreported = true;
         }
     }
+}
 
-    /* reset */
-    pos = 0;
-    return NULL;
+// hands the buffer being filled to the USB driver
+static void writer_post(SerialUSBDriver* sdu)
+{
+    if (writer.buf == NULL) {
+        return;
+    }
+    if (writer.len > 0) {
+        trace_event(TRACE_USB_WRITE, writer.len);
+        chSysLock();
+        // the queue is reset when the link goes down, the buffer is gone
+        bool valid = sdu->obqueue.ptr == writer.buf;
+        if (valid) {
+            obqPostFullBufferS(&sdu->obqueue, writer.len);
+        }
+        chSysUnlock();
+        trace_event(TRACE_USB_WRITE_DONE, valid ? writer.len : 0);
+        if (valid) {
+            serial_written += writer.len;
+            unsigned int i;
+            for (i = 0; i < writer.frames; i++) {
+                latency_add(LATENCY_RX_WRITE, writer.start[i]);
+            }
+        }
+    }
+    writer.buf = NULL;
 }
 
-MUTEX_DECL(serial_lock);
+/* Room for a record of len bytes in an output buffer, NULL if no buffer is
+ * free or the host is away. */
+static uint8_t* writer_reserve(SerialUSBDriver* sdu, size_t len)
+{
+    if (outage.active && !outage_over(sdu)) {
+        return NULL;
+    }
+    if (writer.buf != NULL && sdu->obqueue.ptr != writer.buf) {
+        writer.buf = NULL; // the queue was reset, the buffer is gone
+    }
+    if (writer.buf != NULL && writer.size - writer.len < len) {
+        writer_post(sdu);
+    }
+    if (writer.buf == NULL) {
+        chSysLock();
+        bool got = sdu->config->usbp->state == USB_ACTIVE
+            && obqGetEmptyBufferTimeoutS(&sdu->obqueue, TIME_IMMEDIATE) == MSG_OK;
+        chSysUnlock();
+        if (!got) {
+            writer_stall();
+            return NULL;
+        }
+        writer.buf = sdu->obqueue.ptr;
+        writer.size = sdu->obqueue.top - sdu->obqueue.ptr;
+        writer.len = 0;
+        writer.frames = 0;
+        writer.stalled = false;
+    }
+    return writer.buf + writer.len;
+}
+
+// true if a record can be written without waiting
+static bool writer_ready(SerialUSBDriver* sdu)
+{
+    chSysLock();
+    bool space = bqSpaceI(&sdu->obqueue) > 0;
+    chSysUnlock();
+    return writer.buf != NULL || space;
+}
+
+// copies queued responses to the output, returns true if one was written
+static bool writer_poll(void* arg)
+{
+    bool written = false;
+    while (1) {
+        size_t len;
+        const void* record = record_queue_front(&response_queue, &len);
+        if (record == NULL) {
+            return written;
+        }
+        uint8_t* buf = writer_reserve((SerialUSBDriver*)arg, len);
+        if (buf == NULL) {
+            return written;
+        }
+        memcpy(buf, record, len);
+        writer.len += len;
+        record_queue_pop(&response_queue);
+        written = true;
+    }
+}
+
+/* Time until the next deadline of a waiting transmit line or a stalled
+ * write, at most the tick. The system timer is tick-less, they are met
+ * within the minimum timeout CH_CFG_ST_TIMEDELTA. */
+static systime_t slcan_timeout(void)
+{
+    timestamp_t now = timestamp_get();
+    int32_t wait = SLCAN_TICK_US;
+    if (input.line != NULL) {
+        int32_t left = SLCAN_TX_WAIT - timestamp_duration_us(input.since, now);
+        wait = left < wait ? left : wait;
+    }
+    if (writer.stalled && !outage.active) {
+        int32_t left = SLCAN_WRITE_TIMEOUT - timestamp_duration_us(writer.since, now);
+        wait = left < wait ? left : wait;
+    }
+    return TIMESTAMP_US2ST(wait > 0 ? wait : 1);
+}
 
+/* Queues a response, writes synchronously while the queue is full unless
+ * the host is away, then the response is dropped. */
 int slcan_serial_write(void* arg, const char* buf, size_t len)
 {
-    if (len == 0) {
+    if (len == 0 || len > SLCAN_RECORD_MAX) {
         return 0;
     }
-    chMtxLock(&serial_lock);
-    int ret = chnWriteTimeout((BaseChannel*)arg, (const uint8_t*)buf, len, MS2ST(100));
-    chMtxUnlock(&serial_lock);
-    return ret;
+    while (!record_queue_push(&response_queue, buf, len)) {
+        if (!writer_poll(arg)) {
+            if (outage.active) {
+                return 0;
+            }
+            // the other events stay pending for the loop
+            chEvtWaitAnyTimeout(SLCAN_EVENT_USB, slcan_timeout());
+        }
+    }
+    return len;
 }
 
-THD_WORKING_AREA(slcan_thread, 1000);
-void slcan_thread_main(void* arg)
+/* The receive stream encodes frames in place in the output buffer between
+ * reserve and commit. */
+char* slcan_serial_reserve(void* arg, size_t len)
 {
-    chRegSetThreadName("USB receiver");
-    while (1) {
-        slcan_spin(arg);
+    return (char*)writer_reserve((SerialUSBDriver*)arg, len);
+}
+
+void slcan_serial_commit(void* arg, size_t len, uint32_t start)
+{
+    (void)arg;
+    writer.len += len;
+    if (writer.frames < SLCAN_BUFFER_FRAMES) {
+        writer.start[writer.frames++] = start;
     }
 }
 
-void slcan_rx_spin(void* arg);
+void slcan_serial_stats(uint32_t* written, uint32_t* timeouts)
+{
+    *written = serial_written;
+    *timeouts = serial_timeouts;
+}
+
+void slcan_serial_stats_reset(void)
+{
+    serial_written = 0;
+    serial_timeouts = 0;
+}
 
-THD_WORKING_AREA(slcan_rx_thread, 1000);
-void slcan_rx_thread_main(void* arg)
+/* Called before each frame of the receive stream. Once the host is back
+ * the outage record is queued at the position of the gap. */
+bool slcan_host_ready(void* arg)
 {
-    chRegSetThreadName("CAN receiver");
+    if (outage.active && !outage_over((SerialUSBDriver*)arg)) {
+        return false;
+    }
+    if (outage.unreported) {
+        char* buf = slcan_serial_reserve(arg, SLCAN_MAX_FRAME_LEN);
+        if (buf == NULL) {
+            return false;
+        }
+        uint32_t s = outage.start / 1000;
+        uint32_t duration = (outage.end - outage.start) / 1000;
+        struct can_frame_s f = {
+            .id = CAN_EVENT_HOST_OUTAGE,
+            .event = 1,
+            .timestamp = can_timestamp(outage.start),
+            .length = 8,
+            .data = {s >> 24, s >> 16, s >> 8, s,
+                     duration >> 24, duration >> 16, duration >> 8, duration}};
+        writer.len += slcan_record_to_ascii(buf, &f);
+        outage.unreported = false;
+    }
+    return true;
+}
+
+static THD_WORKING_AREA(slcan_thread_wa, 1000);
+static THD_FUNCTION(slcan_thread_main, arg)
+{
+    chRegSetThreadName("SLCAN");
+    chEvtRegisterMaskWithFlags(chnGetEventSource((BaseChannel*)arg), &usb_listener, SLCAN_EVENT_USB,
+                               CHN_INPUT_AVAILABLE | CHN_OUTPUT_EMPTY);
+    can_notify(SLCAN_EVENT_CAN_RX, SLCAN_EVENT_CAN_TX);
     while (1) {
-        slcan_rx_spin(arg);
+        if (((SerialUSBDriver*)arg)->config->usbp->state != USB_ACTIVE) {
+            /* USB link down, drop the partial line */
+            input_reset();
+        }
+        writer_poll(arg);
+        bool frames = slcan_rx_spin(arg, SLCAN_FRAMES_PER_PASS);
+        unsigned int lines = 0;
+        while (lines < SLCAN_LINES_PER_PASS && slcan_spin(arg)) {
+            lines++;
+        }
+        writer_poll(arg);
+        writer_post(arg);
+        if (frames || lines == SLCAN_LINES_PER_PASS) {
+            continue; // more input may be waiting
+        }
+        // received frames are only of interest if there is room for them
+        eventmask_t wait = SLCAN_EVENT_USB | SLCAN_EVENT_CAN_TX;
+        if (writer_ready(arg)) {
+            wait |= SLCAN_EVENT_CAN_RX;
+        }
+        chEvtWaitAnyTimeout(wait, slcan_timeout());
     }
 }
 
 void slcan_start(BaseChannel* ch)
 {
     can_init();
-    chThdCreateStatic(slcan_thread, sizeof(slcan_thread), NORMALPRIO, slcan_thread_main, ch);
-    chThdCreateStatic(slcan_rx_thread, sizeof(slcan_rx_thread), NORMALPRIO, slcan_rx_thread_main, ch);
+    can_replay_init();
+    can_generator_init();
+    record_queue_init(&response_queue, response_buf, sizeof(response_buf));
+    input_reset();
+    chThdCreateStatic(slcan_thread_wa, sizeof(slcan_thread_wa), NORMALPRIO, slcan_thread_main, ch);
 }
@@ -1,4 +1,5 @@
 #include "timestamp.h"
+#include "ramfunc.h"
 
 int32_t timestamp_duration_us(timestamp_t t1, timestamp_t t2)
 {
@@ -19,3 +20,14 @@ float ltimestamp_duration_s(ltimestamp_t t1, ltimestamp_t t2)
 {
     return (float)ltimestamp_duration_us(t1, t2) / 1000000.f;
 }
+
+RAMFUNC ltimestamp_t ltimestamp_extend(uint32_t epoch, uint32_t counter, uint32_t* next)
+{
+    uint32_t high = epoch >> 1;
+    uint32_t top = counter >> 31;
+    if ((epoch & 1) && !top) {
+        high++;
+    }
+    *next = (high << 1) | top;
+    return ((uint64_t)high << 32) | counter;
+}
@@ -38,6 +38,18 @@ float timestamp_duration_s(timestamp_t t1, timestamp_t t2);
 int64_t ltimestamp_duration_us(ltimestamp_t t1, ltimestamp_t t2);
 float ltimestamp_duration_s(ltimestamp_t t1, ltimestamp_t t2);
 
+/*
+ * Extend a free running 32 bit us counter to a long timestamp
+ *  The epoch holds the upper word and the top bit of the counter as last
+ *  seen. A wrap shows as the top bit going from 1 to 0. The caller reads the
+ *  epoch before the counter and stores *next back if it changed, a single
+ *  store without locks or loops, so it works from any context as long as
+ *  the counter is read at least once every half wrap (35 minutes). A caller
+ *  preempted before its store can write back an older epoch, that is still
+ *  within half a wrap and corrected by the next call.
+ */
+ltimestamp_t ltimestamp_extend(uint32_t epoch, uint32_t counter, uint32_t* next);
+
 #ifdef __cplusplus
 }
 #endif
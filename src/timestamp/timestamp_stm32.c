@@ -1,80 +1,83 @@
 #include <stdlib.h>
 #include <stdint.h>
 
-static volatile uint32_t time_us_low;
-static volatile uint32_t time_us_high;
+// upper word and top counter bit, see ltimestamp_extend()
+static volatile uint32_t time_us_epoch;
 
 // ChibiOS specific begin
 #include <ch.h>
 #include <hal.h>
 #include "timestamp.h"
+#include "ramfunc.h"
 
 // settings
 #include <timestamp_stm32_settings.h>
 
-static inline uint32_t timer_read(void)
+#if COUNTER_MAX != 0xffffffff
+#error "timestamps need a 32 bit timer"
+#endif
+
+#if defined(TIMESTAMP_SYSTEM_TIMER) && (CH_CFG_ST_TIMEDELTA == 0 || CH_CFG_ST_FREQUENCY != 1000000)
+#error "the shared system timer must be tick-less at 1 MHz"
+#endif
+
+static virtual_timer_t timestamp_vt;
+
+// keeps the epoch current when nothing reads the time for half a wrap
+static void timestamp_refresh(void* arg)
 {
-    uint32_t tim_reg = TIMER_REG->CNT;
-    while (TIMER_REG->SR & STM32_TIM_SR_UIF)
-        ; // make sure there is no interrupt pending TODO won't work in interrupts
-    return tim_reg;
+    (void)arg;
+    ltimestamp_get();
+    chSysLockFromISR();
+    chVTSetI(&timestamp_vt, S2ST(EPOCH_REFRESH_S), timestamp_refresh, NULL);
+    chSysUnlockFromISR();
 }
 
-CH_FAST_IRQ_HANDLER(TIMER_IRQ_NAME)
+static inline uint32_t timer_read(void)
 {
-    TIMER_REG->SR &= ~STM32_TIM_SR_UIF; // clear interrupt flag
-    time_us_low += COUNTER_MAX;
-    // todo
+    return TIMER_REG->CNT;
 }
 
+// called locked
 void timestamp_stm32_init(void)
 {
-    time_us_low = 0;
-    time_us_high = 0;
+    time_us_epoch = 0;
+#ifndef TIMESTAMP_SYSTEM_TIMER
     RCC_EN();
     RCC_RESET();
-    nvicEnableVector(NVIC_NB, INTERRUPT_PRIO);
     TIMER_REG->ARR = COUNTER_MAX;
     TIMER_REG->PSC = PRESCALER;
-    TIMER_REG->DIER = STM32_TIM_DIER_UIE; // enable update interrupt
+    TIMER_REG->EGR = STM32_TIM_EGR_UG; // load the prescaler
     TIMER_REG->CR1 |= STM32_TIM_CR1_CEN; // enable timer
+#endif
+    chVTObjectInit(&timestamp_vt);
+    chVTSetI(&timestamp_vt, S2ST(EPOCH_REFRESH_S), timestamp_refresh, NULL);
 }
 // ChibiOS specific end
 
-timestamp_t timestamp_get()
+RAMFUNC timestamp_t timestamp_get()
 {
-    uint32_t t1 = time_us_low;
-    uint32_t tim = timer_read();
-    uint32_t t2 = time_us_low;
-    if (t2 != t1) {
-        return t2;
-    }
-    return t1 + tim;
+    return timer_read();
 }
 
-ltimestamp_t ltimestamp_get()
+RAMFUNC ltimestamp_t ltimestamp_get()
 {
-    uint32_t t1 = time_us_low;
-    uint32_t th = time_us_high;
-    uint32_t tim = timer_read();
-    uint32_t t2 = time_us_low;
-    if (t2 != t1) {
-        if (t2 < t1) { // time_us_low overflow
-            return ((uint64_t)(th + 1) << 32) + t2;
-        } else {
-            return ((uint64_t)th << 32) + t2;
-        }
+    uint32_t epoch = time_us_epoch; // before the counter
+    uint32_t next;
+    ltimestamp_t t = ltimestamp_extend(epoch, timer_read(), &next);
+    if (next != epoch) {
+        time_us_epoch = next;
     }
-    return ((uint64_t)th << 32) + t1 + tim;
+    return t;
 }
 
 // test to make sure timestamps are monotonic
 bool _timestamp_test(void)
 {
-    timestamp_t t = timestamp_get();
+    ltimestamp_t t = ltimestamp_get();
     while (1) {
-        timestamp_t t_now = timestamp_get();
-        if (timestamp_duration_us(t, t_now) < 0) {
+        ltimestamp_t t_now = ltimestamp_get();
+        if (ltimestamp_duration_us(t, t_now) < 0) {
             return false;
         }
         t = t_now;
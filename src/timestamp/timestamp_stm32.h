@@ -1,12 +1,22 @@
 #ifndef TIMESTAMP_STM32_H
 #define TIMESTAMP_STM32_H
 
+#include <ch.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void timestamp_stm32_init(void);
 
+/* System time interval from us
+ * US2ST() overflows past 4294 us with a 1 MHz system timer. */
+#if CH_CFG_ST_FREQUENCY == 1000000
+#define TIMESTAMP_US2ST(us) ((systime_t)(us))
+#else
+#define TIMESTAMP_US2ST(us) ((systime_t)(((uint64_t)(us)*CH_CFG_ST_FREQUENCY + 999999) / 1000000))
+#endif
+
 #ifdef __cplusplus
 }
 #endif
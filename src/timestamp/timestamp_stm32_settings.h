@@ -8,14 +8,13 @@ extern "C" {
 #include <ch.h>
 
 // settings
-#define TIMESTAMP_TIMER TIM7
-#define TIMER_REG STM32_TIM7
-#define TIMER_IRQ_NAME STM32_TIM7_HANDLER
-#define RCC_EN() rccEnableTIM7(FALSE)
-#define RCC_RESET() rccResetTIM7()
-#define NVIC_NB STM32_TIM7_NUMBER
+// free running 32 bit timer, no interrupt
+#define TIMESTAMP_TIMER TIM2
+#define TIMER_REG STM32_TIM2
+#define RCC_EN() rccEnableTIM2(FALSE)
+#define RCC_RESET() rccResetTIM2()
 
-#define COUNTER_MAX 0xffff
+#define COUNTER_MAX 0xffffffff
 
 // CK_CNT = CK_INT / (PSC[15:0] + 1)
 #if STM32_PPRE1 == STM32_PPRE1_DIV1
@@ -23,7 +22,9 @@ extern "C" {
 #else
 #define PRESCALER (2 * STM32_PCLK1 / 1000000 - 1)
 #endif
-#define INTERRUPT_PRIO 5
+
+// [s] the epoch must be refreshed within half a wrap
+#define EPOCH_REFRESH_S 60
 
 #ifdef __cplusplus
 }
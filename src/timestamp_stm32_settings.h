@@ -8,14 +8,15 @@ extern "C" {
 #include <ch.h>
 
 // settings
-#define TIMESTAMP_TIMER TIM6
-#define TIMER_REG STM32_TIM6
-#define TIMER_IRQ_NAME STM32_TIM6_HANDLER
-#define RCC_EN() rccEnableTIM6(FALSE)
-#define RCC_RESET() rccResetTIM6()
-#define NVIC_NB STM32_TIM6_NUMBER
+// free running 32 bit timer, no interrupt
+// TIM2 is also the tick-less system timer at 1 MHz, started by the HAL
+#define TIMESTAMP_SYSTEM_TIMER
+#define TIMESTAMP_TIMER TIM2
+#define TIMER_REG STM32_TIM2
+#define RCC_EN() rccEnableTIM2(FALSE)
+#define RCC_RESET() rccResetTIM2()
 
-#define COUNTER_MAX 0xffff
+#define COUNTER_MAX 0xffffffff
 
 // CK_CNT = CK_INT / (PSC[15:0] + 1)
 #if STM32_PPRE1 == STM32_PPRE1_DIV1
@@ -23,7 +24,9 @@ extern "C" {
 #else
 #define PRESCALER (2 * STM32_PCLK1 / 1000000 - 1)
 #endif
-#define INTERRUPT_PRIO 5
+
+// [s] the epoch must be refreshed within half a wrap
+#define EPOCH_REFRESH_S 60
 
 #ifdef __cplusplus
 }
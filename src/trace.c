@@ -0,0 +1,34 @@
+#include <string.h>
+#include "trace.h"
+
+void trace_init(struct trace_s* t)
+{
+    memset(t, 0, sizeof(*t));
+    t->enabled = true;
+}
+
+void trace_add(struct trace_s* t, uint32_t time, uint8_t event, uint16_t arg)
+{
+    if (!t->enabled) {
+        return;
+    }
+    struct trace_record_s* r = &t->records[t->head % TRACE_SIZE];
+    r->time = time;
+    r->event = event;
+    r->reserved = 0;
+    r->arg = arg;
+    t->head++;
+}
+
+unsigned int trace_count(const struct trace_s* t)
+{
+    return t->head < TRACE_SIZE ? t->head : TRACE_SIZE;
+}
+
+const struct trace_record_s* trace_get(const struct trace_s* t, unsigned int i)
+{
+    if (i >= trace_count(t)) {
+        return NULL;
+    }
+    return &t->records[(t->head - trace_count(t) + i) % TRACE_SIZE];
+}
@@ -0,0 +1,89 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* capacity in records, 8 bytes each */
+#if !defined(TRACE_SIZE)
+#define TRACE_SIZE 128
+#endif
+#if (TRACE_SIZE & (TRACE_SIZE - 1)) != 0
+#error "TRACE_SIZE must be a power of 2"
+#endif
+
+/* trace points, see README.md for the argument of each */
+enum {
+    TRACE_SWITCH = 1, // context switch, ID of the new thread
+    TRACE_IRQ, // interrupt active at an interrupt sample, NVIC number
+    TRACE_CAN_RX, // frame read from the controller, ID
+    TRACE_RX_POST, // receive queue post, queue fill
+    TRACE_RX_DROP, // receive queue full, dropped frames
+    TRACE_RX_FETCH, // receive queue fetch
+    TRACE_ENCODE, // frame encoded, length
+    TRACE_USB_WRITE, // USB write started, length
+    TRACE_USB_WRITE_DONE, // USB write returned, bytes written
+    TRACE_LINE, // command line received, length
+    TRACE_CAN_TX, // transmit mailbox request accepted, ID
+    TRACE_CAN_TX_FAIL, // transmit mailbox request failed, ID
+};
+
+struct trace_record_s {
+    uint32_t time; // CPU cycles
+    uint8_t event;
+    uint8_t reserved;
+    uint16_t arg;
+};
+
+/* ring of the most recent records */
+struct trace_s {
+    struct trace_record_s records[TRACE_SIZE];
+    uint32_t head; // number of records ever written
+    bool enabled;
+};
+
+void trace_init(struct trace_s* t);
+void trace_add(struct trace_s* t, uint32_t time, uint8_t event, uint16_t arg);
+unsigned int trace_count(const struct trace_s* t);
+/* i-th record, oldest first */
+const struct trace_record_s* trace_get(const struct trace_s* t, unsigned int i);
+
+/* Binary dump
+ * header, thread table and records, all little endian
+ */
+#define TRACE_DUMP_MAGIC 0x4352544a // "JTRC"
+#define TRACE_DUMP_NAME_LEN 14
+
+struct trace_dump_header_s {
+    uint32_t magic;
+    uint32_t clock; // CPU cycles per second
+    uint16_t count; // number of records
+    uint8_t threads; // number of thread table entries
+    uint8_t reserved;
+};
+
+struct trace_dump_thread_s {
+    uint16_t id; // TRACE_SWITCH argument
+    char name[TRACE_DUMP_NAME_LEN];
+};
+
+/* global trace, records from threads and interrupts */
+void trace_event(uint8_t event, uint16_t arg);
+void trace_start(void);
+void trace_stop(void);
+/* stop after the next TRACE_RX_DROP record */
+void trace_stop_on_drop(bool enable);
+/* writes the binary dump using write(arg, buf, len), tracing is stopped */
+size_t trace_dump(int (*write)(void* arg, const char* buf, size_t len), void* arg);
+size_t trace_dump_size(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRACE_H */
@@ -0,0 +1,85 @@
+#include <ch.h>
+#include <hal.h>
+#include <string.h>
+#include "trace.h"
+
+static struct trace_s trace;
+static bool trace_drop_stop = false;
+
+void trace_event(uint8_t event, uint16_t arg)
+{
+    syssts_t sts = chSysGetStatusAndLockX();
+    trace_add(&trace, DWT->CYCCNT, event, arg);
+    if (event == TRACE_RX_DROP && trace_drop_stop) {
+        trace.enabled = false;
+    }
+    chSysRestoreStatusX(sts);
+}
+
+void trace_start(void)
+{
+    chSysLock();
+    trace_init(&trace);
+    chSysUnlock();
+}
+
+void trace_stop(void)
+{
+    chSysLock();
+    trace.enabled = false;
+    chSysUnlock();
+}
+
+void trace_stop_on_drop(bool enable)
+{
+    trace_drop_stop = enable;
+}
+
+static unsigned int trace_thread_count(void)
+{
+    unsigned int n = 0;
+    thread_t* tp = chRegFirstThread();
+    while (tp != NULL) {
+        n++;
+        tp = chRegNextThread(tp);
+    }
+    return n;
+}
+
+size_t trace_dump_size(void)
+{
+    return sizeof(struct trace_dump_header_s)
+        + trace_thread_count() * sizeof(struct trace_dump_thread_s)
+        + trace_count(&trace) * sizeof(struct trace_record_s);
+}
+
+size_t trace_dump(int (*write)(void* arg, const char* buf, size_t len), void* arg)
+{
+    trace_stop();
+    size_t len = 0;
+    struct trace_dump_header_s h = {
+        .magic = TRACE_DUMP_MAGIC,
+        .clock = STM32_SYSCLK,
+        .count = trace_count(&trace),
+        .threads = trace_thread_count(),
+    };
+    len += write(arg, (const char*)&h, sizeof(h));
+
+    thread_t* tp = chRegFirstThread();
+    while (tp != NULL) {
+        struct trace_dump_thread_s t;
+        memset(&t, 0, sizeof(t));
+        t.id = (uint16_t)(uintptr_t)tp;
+        if (tp->p_name != NULL) {
+            strncpy(t.name, tp->p_name, sizeof(t.name));
+        }
+        len += write(arg, (const char*)&t, sizeof(t));
+        tp = chRegNextThread(tp);
+    }
+
+    unsigned int i;
+    for (i = 0; i < h.count; i++) {
+        len += write(arg, (const char*)trace_get(&trace, i), sizeof(struct trace_record_s));
+    }
+    return len;
+}
@@ -0,0 +1,54 @@
+#include <stddef.h>
+#include "tx_mailbox.h"
+
+void tx_mailbox_init(struct tx_mailbox_s* m)
+{
+    unsigned int i;
+    for (i = 0; i < TX_MAILBOX_COUNT; i++) {
+        m->done[i] = NULL;
+        m->tag[i] = 0;
+        m->pending[i] = 0;
+    }
+}
+
+unsigned int tx_mailbox_pick(const struct tx_mailbox_s* m, uint32_t empty)
+{
+    unsigned int i;
+    for (i = 0; i < TX_MAILBOX_COUNT; i++) {
+        if ((empty & (1 << i)) && !m->pending[i]) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+void tx_mailbox_load(struct tx_mailbox_s* m, unsigned int mailbox, tx_done_t done, uint32_t tag)
+{
+    m->done[mailbox - 1] = done;
+    m->tag[mailbox - 1] = tag;
+    m->pending[mailbox - 1] = 1;
+}
+
+void tx_mailbox_cancel(struct tx_mailbox_s* m, unsigned int mailbox)
+{
+    m->pending[mailbox - 1] = 0;
+}
+
+uint32_t tx_mailbox_complete(struct tx_mailbox_s* m, uint32_t flags, const ltimestamp_t* sof)
+{
+    uint32_t accounted = 0;
+    unsigned int i;
+    for (i = 0; i < TX_MAILBOX_COUNT; i++) {
+        bool failed = flags & (1 << (i + 16));
+        if (!m->pending[i] || !((flags & (1 << i)) || failed)) {
+            continue;
+        }
+        if (m->done[i] != NULL) {
+            m->done[i](m->tag[i], sof[i], !failed);
+        }
+        // the mailbox can be loaded again
+        m->pending[i] = 0;
+        accounted |= 1 << i;
+    }
+    return accounted;
+}
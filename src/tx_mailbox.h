@@ -0,0 +1,55 @@
+#ifndef TX_MAILBOX_H
+#define TX_MAILBOX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <timestamp/timestamp.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TX_MAILBOX_COUNT 3 // bxCAN transmit mailboxes
+
+/* called when the request of a mailbox is done, sof is the start of frame
+ * of the transmission [us], ok is false if the controller reported an error
+ * or lost arbitration for it */
+typedef void (*tx_done_t)(uint32_t tag, ltimestamp_t sof, bool ok);
+
+/* Transmit mailbox bookkeeping
+ * Every request is recorded with the mailbox it is loaded into. A mailbox
+ * is loaded again only once its completion is accounted, so completions
+ * reported together in one set of event flags can't be mixed up. The
+ * pending bytes are written by the loading thread while they are clear and
+ * by the accounting thread while they are set, no lock is needed.
+ */
+struct tx_mailbox_s {
+    tx_done_t done[TX_MAILBOX_COUNT];
+    uint32_t tag[TX_MAILBOX_COUNT];
+    volatile uint8_t pending[TX_MAILBOX_COUNT];
+};
+
+void tx_mailbox_init(struct tx_mailbox_s* m);
+
+/* first mailbox (1 based) among the empty ones (bit per mailbox) that was
+ * accounted, 0 if there is none */
+unsigned int tx_mailbox_pick(const struct tx_mailbox_s* m, uint32_t empty);
+
+/* records the request loaded into the mailbox, done can be NULL */
+void tx_mailbox_load(struct tx_mailbox_s* m, unsigned int mailbox, tx_done_t done, uint32_t tag);
+
+/* the request couldn't be loaded */
+void tx_mailbox_cancel(struct tx_mailbox_s* m, unsigned int mailbox);
+
+/* Accounts the completions of the pending mailboxes in flags, the done
+ * ones in the lower half and those with an error in the upper half, as
+ * reported by the ChibiOS CAN driver. sof holds the start of frame of each
+ * mailbox. Returns the mailboxes accounted (bit per mailbox).
+ */
+uint32_t tx_mailbox_complete(struct tx_mailbox_s* m, uint32_t flags, const ltimestamp_t* sof);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TX_MAILBOX_H */
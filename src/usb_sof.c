@@ -0,0 +1,25 @@
+#include <ch.h>
+#include <hal.h>
+#include "usb_sof.h"
+
+static ltimestamp_t usb_sof_time;
+static uint16_t usb_sof_frame;
+static bool usb_sof_seen = false;
+
+void usb_sof_latch(uint16_t frame)
+{
+    usb_sof_time = ltimestamp_get();
+    usb_sof_frame = frame;
+    usb_sof_seen = true;
+}
+
+bool usb_sof_get(struct usb_sof_s* s)
+{
+    chSysLock();
+    bool seen = usb_sof_seen;
+    s->frame = usb_sof_frame;
+    s->time = usb_sof_time;
+    s->now = ltimestamp_get();
+    chSysUnlock();
+    return seen;
+}
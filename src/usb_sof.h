@@ -0,0 +1,33 @@
+#ifndef USB_SOF_H
+#define USB_SOF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <timestamp/timestamp.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* USB start of frame clock reference
+ * The host controller starts a frame every ms and numbers it with 11 bits.
+ * The time of the last start of frame is latched in the SOF interrupt
+ * together with its number, the pairs relate the us clock to the host's.
+ */
+struct usb_sof_s {
+    uint16_t frame;
+    ltimestamp_t time; // start of frame [us]
+    ltimestamp_t now; // time of the query [us]
+};
+
+/* called from the SOF interrupt */
+void usb_sof_latch(uint16_t frame);
+
+/* last start of frame, false if none was seen yet */
+bool usb_sof_get(struct usb_sof_s* s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* USB_SOF_H */
@@ -1,4 +1,5 @@
 #include "usbcfg2.h"
+#include "usb_sof.h"
 
 /*Endpoints to be used for USBD1.  */
 #define USBD1_DATA_REQUEST_EP 1
@@ -234,12 +235,18 @@ static void usb_event(USBDriver* usbp, usbevent_t event)
     return;
 }
 
+/** Latches the start of frame time, see usb_sof.h.  */
+static void usb_sof(USBDriver* usbp)
+{
+    usb_sof_latch(usbGetFrameNumberX(usbp));
+}
+
 /** USB driver configuration.  */
 const USBConfig usbcfg = {
     usb_event,
     get_descriptor,
     sduRequestsHook,
-    NULL};
+    usb_sof};
 
 /** Serial over USB driver configuration.  */
 const SerialUSBConfig serusbcfg = {
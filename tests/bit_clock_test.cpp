@@ -0,0 +1,94 @@
+#include "CppUTest/TestHarness.h"
+#include "../src/bit_clock.h"
+
+TEST_GROUP (BitClock) {
+    struct bit_clock_s c;
+    uint16_t phase = 0x1234;
+
+    void setup()
+    {
+        bit_clock_init(&c, 1000000);
+    }
+
+    // counter value latched at t [us]
+    uint16_t latch(uint64_t t)
+    {
+        return t * c.bitrate / 1000000 + phase;
+    }
+};
+
+TEST(BitClock, UnsynchronizedReturnsNow)
+{
+    CHECK_EQUAL(5000, bit_clock_sof(&c, 0, 5000));
+}
+
+TEST(BitClock, ShortestReadLatencyWins)
+{
+    bit_clock_sync(&c, latch(10000), 100, 10000 + 100 + 500);
+    bit_clock_sync(&c, latch(20000), 100, 20000 + 100 + 20);
+    bit_clock_sync(&c, latch(30000), 100, 30000 + 100 + 300);
+    CHECK_EQUAL(phase - 20, c.phase);
+    // every frame is late by the same 20 us, whatever its read latency
+    CHECK_EQUAL(40000 + 20, bit_clock_sof(&c, latch(40000), 40000 + 2000));
+    CHECK_EQUAL(50000 + 20, bit_clock_sof(&c, latch(50000), 50000 + 150));
+}
+
+TEST(BitClock, ExactWithoutReadLatency)
+{
+    bit_clock_sync(&c, latch(1000), 64, 1000 + 64);
+    CHECK_EQUAL(phase, c.phase);
+    CHECK_EQUAL(2000, bit_clock_sof(&c, latch(2000), 2000 + 300));
+}
+
+TEST(BitClock, CounterWraps)
+{
+    uint64_t t = 10ULL * 65536 - 10;
+    bit_clock_sync(&c, latch(t), 64, t + 64);
+    CHECK_EQUAL(t, bit_clock_sof(&c, latch(t), t + 100));
+    CHECK_EQUAL(t + 30, bit_clock_sof(&c, latch(t + 30), t + 100));
+}
+
+TEST(BitClock, SlowerBitrate)
+{
+    bit_clock_init(&c, 125000);
+    uint64_t t = 3ULL * 1000000 * 3600; // 3 hours, past the 32 bit us wrap
+    bit_clock_sync(&c, latch(t), 64, t + 64 * 8);
+    CHECK_EQUAL(t, bit_clock_sof(&c, latch(t), t + 64 * 8));
+    CHECK_EQUAL(t + 8000, bit_clock_sof(&c, latch(t + 8000), t + 20000));
+}
+
+TEST(BitClock, Improves)
+{
+    CHECK_TRUE(bit_clock_improves(&c, latch(1000), 64, 1000 + 64 + 10));
+    bit_clock_sync(&c, latch(1000), 64, 1000 + 64 + 10);
+    CHECK_FALSE(bit_clock_improves(&c, latch(2000), 64, 2000 + 64 + 10));
+    CHECK_FALSE(bit_clock_improves(&c, latch(2000), 64, 2000 + 64 + 20));
+    CHECK_TRUE(bit_clock_improves(&c, latch(2000), 64, 2000 + 64 + 5));
+}
+
+TEST(BitClock, FollowsDriftingLatch)
+{
+    // the bus clock runs 100 ppm slow, 1 ms of drift in 10 s
+    for (uint64_t i = 1; i <= 10000; i++) {
+        uint64_t t = i * 1000;
+        uint16_t time = t - t / 10000 + phase;
+        // one frame in eight is read 3 us after its end
+        uint64_t latency = i % 8 == 0 ? 3 : 100 + (i * 37) % 200;
+        bit_clock_sync(&c, time, 100, t + 100 + latency);
+        uint64_t sof = bit_clock_sof(&c, time, t + 100 + latency);
+        if (i > 8) {
+            CHECK(sof >= t && sof <= t + 6);
+        }
+    }
+}
+
+TEST(BitClock, KeepsEstimateWithoutFrames)
+{
+    bit_clock_sync(&c, latch(1000), 64, 1000 + 64);
+    CHECK_EQUAL(500000, bit_clock_sof(&c, latch(500000), 500000 + 300));
+    // a worse bound replaces the estimate once the windows have passed
+    bit_clock_sync(&c, latch(600000), 64, 600000 + 64 + 10);
+    CHECK_FALSE(bit_clock_improves(&c, latch(600500), 64, 600500 + 64 + 20));
+    bit_clock_sync(&c, latch(620000), 64, 620000 + 64 + 10);
+    CHECK_EQUAL(phase - 10, c.phase);
+}
@@ -0,0 +1,146 @@
+#include "CppUTest/TestHarness.h"
+#include "../src/capture.h"
+
+static struct can_frame_s make_frame(uint32_t id, uint32_t timestamp)
+{
+    struct can_frame_s f;
+    memset(&f, 0, sizeof(f));
+    f.id = id;
+    f.timestamp = timestamp;
+    f.length = 2;
+    f.data[0] = id >> 8;
+    f.data[1] = id;
+    return f;
+}
+
+TEST_GROUP (Capture) {
+    struct capture_s c;
+    struct capture_trigger_s t;
+
+    void setup()
+    {
+        capture_init(&c);
+        memset(&t, 0, sizeof(t));
+        t.type = CAPTURE_TRIGGER_FRAME;
+        t.id = 0x100;
+        t.mask = 0x7ff;
+    }
+
+    void feed(uint32_t first, uint32_t last)
+    {
+        uint32_t id;
+        for (id = first; id <= last; id++) {
+            struct can_frame_s f = make_frame(id, id);
+            capture_frame(&c, &f);
+        }
+    }
+};
+
+TEST(Capture, IdleDoesNotRecord)
+{
+    feed(0x0f0, 0x110);
+    CHECK_EQUAL(CAPTURE_IDLE, c.state);
+    POINTERS_EQUAL(NULL, capture_get(&c, 0));
+}
+
+TEST(Capture, WindowMustFit)
+{
+    CHECK_FALSE(capture_arm(&c, &t, CAPTURE_SIZE / 2, CAPTURE_SIZE / 2));
+    CHECK_TRUE(capture_arm(&c, &t, CAPTURE_SIZE / 2, CAPTURE_SIZE / 2 - 1));
+}
+
+TEST(Capture, KeepsFramesAroundTrigger)
+{
+    capture_arm(&c, &t, 3, 2);
+    feed(0x0f0, 0x0ff);
+    CHECK_EQUAL(CAPTURE_ARMED, c.state);
+    feed(0x100, 0x100);
+    CHECK_EQUAL(CAPTURE_TRIGGERED, c.state);
+    feed(0x101, 0x110);
+    CHECK_EQUAL(CAPTURE_DONE, c.state);
+
+    CHECK_EQUAL(6, c.count);
+    const uint32_t expected[] = {0x0fd, 0x0fe, 0x0ff, 0x100, 0x101, 0x102};
+    unsigned int i;
+    for (i = 0; i < 6; i++) {
+        CHECK_EQUAL(expected[i], capture_get(&c, i)->id);
+    }
+    POINTERS_EQUAL(NULL, capture_get(&c, 6));
+}
+
+TEST(Capture, ReportsCompletion)
+{
+    capture_arm(&c, &t, 0, 1);
+    struct can_frame_s f = make_frame(0x100, 0);
+    CHECK_FALSE(capture_frame(&c, &f));
+    CHECK_TRUE(capture_frame(&c, &f));
+    CHECK_FALSE(capture_frame(&c, &f));
+    CHECK_EQUAL(2, c.count);
+}
+
+TEST(Capture, PreTriggerWrapsAround)
+{
+    capture_arm(&c, &t, CAPTURE_SIZE - 1, 0);
+    feed(0x000, 0x0ff);
+    struct can_frame_s f = make_frame(0x100, 0);
+    CHECK_TRUE(capture_frame(&c, &f));
+    CHECK_EQUAL(CAPTURE_DONE, c.state);
+    CHECK_EQUAL(CAPTURE_SIZE, c.count);
+    CHECK_EQUAL(0x100 - (CAPTURE_SIZE - 1), capture_get(&c, 0)->id);
+    CHECK_EQUAL(0x100, capture_get(&c, CAPTURE_SIZE - 1)->id);
+}
+
+TEST(Capture, FreezeStopsRecording)
+{
+    capture_arm(&c, &t, 4, 4);
+    feed(0x000, 0x001);
+    capture_freeze(&c);
+    feed(0x100, 0x110);
+    CHECK_EQUAL(CAPTURE_DONE, c.state);
+    CHECK_EQUAL(2, c.count);
+}
+
+TEST(Capture, IdMaskMatch)
+{
+    t.id = 0x120;
+    t.mask = 0x7f0;
+    struct can_frame_s f = make_frame(0x12a, 0);
+    CHECK_TRUE(capture_trigger_match(&t, &f));
+    f.id = 0x13a;
+    CHECK_FALSE(capture_trigger_match(&t, &f));
+    f.id = 0x12a;
+    f.extended = 1;
+    CHECK_FALSE(capture_trigger_match(&t, &f));
+}
+
+TEST(Capture, PayloadMatch)
+{
+    t.length = 2;
+    t.data[0] = 0xa0;
+    t.data_mask[0] = 0xf0;
+    t.data[1] = 0x01;
+    t.data_mask[1] = 0xff;
+    struct can_frame_s f = make_frame(0x100, 0);
+    f.data[0] = 0xab;
+    f.data[1] = 0x01;
+    CHECK_TRUE(capture_trigger_match(&t, &f));
+    f.data[1] = 0x02;
+    CHECK_FALSE(capture_trigger_match(&t, &f));
+    f.data[1] = 0x01;
+    f.length = 1;
+    CHECK_FALSE(capture_trigger_match(&t, &f));
+}
+
+TEST(Capture, ErrorTriggers)
+{
+    struct can_frame_s f = make_frame(CAN_EVENT_BUS_ERROR, 0);
+    f.event = 1;
+    f.data[0] = CAN_ERROR_FRAME;
+    CHECK_FALSE(capture_trigger_match(&t, &f));
+    t.type = CAPTURE_TRIGGER_ERROR;
+    CHECK_TRUE(capture_trigger_match(&t, &f));
+    t.type = CAPTURE_TRIGGER_BUS_OFF;
+    CHECK_FALSE(capture_trigger_match(&t, &f));
+    f.data[0] = CAN_ERROR_BUS_OFF | CAN_ERROR_PASSIVE;
+    CHECK_TRUE(capture_trigger_match(&t, &f));
+}
@@ -0,0 +1,66 @@
+#include "CppUTest/TestHarness.h"
+#include <cstring>
+#include "../src/frame_bits.h"
+
+TEST_GROUP (FrameBits) {
+    struct can_frame_s frame(uint32_t id, bool extended, bool remote, uint8_t length, uint8_t fill)
+    {
+        struct can_frame_s f;
+        memset(&f, 0, sizeof(f));
+        f.id = id;
+        f.extended = extended;
+        f.remote = remote;
+        f.length = length;
+        memset(f.data, fill, sizeof(f.data));
+        return f;
+    }
+};
+
+TEST(FrameBits, StandardFrames)
+{
+    struct can_frame_s f = frame(0x123, false, false, 2, 0);
+    f.data[0] = 0x11;
+    f.data[1] = 0x22;
+    CHECK_EQUAL(62, frame_bits(&f));
+    f = frame(0x7ff, false, false, 0, 0);
+    CHECK_EQUAL(47, frame_bits(&f));
+    f = frame(0x555, false, false, 8, 0x55);
+    CHECK_EQUAL(109, frame_bits(&f)); // only the CRC is stuffed
+}
+
+TEST(FrameBits, AllZeroFrame)
+{
+    struct can_frame_s f = frame(0, false, false, 8, 0);
+    CHECK_EQUAL(124, frame_bits(&f));
+}
+
+TEST(FrameBits, ExtendedFrames)
+{
+    struct can_frame_s f = frame(0x12345678, true, false, 8, 0xff);
+    CHECK_EQUAL(141, frame_bits(&f));
+    f = frame(0x1fffffff, true, true, 8, 0);
+    CHECK_EQUAL(71, frame_bits(&f));
+}
+
+TEST(FrameBits, RemoteFramesHaveNoData)
+{
+    struct can_frame_s f = frame(0x7ff, false, true, 0, 0);
+    CHECK_EQUAL(47, frame_bits(&f));
+    f.length = 8;
+    CHECK_EQUAL(frame_bits_unstuffed(&f), 44);
+}
+
+TEST(FrameBits, Bounds)
+{
+    struct can_frame_s f = frame(0, false, false, 8, 0);
+    CHECK_EQUAL(108, frame_bits_unstuffed(&f));
+    CHECK_EQUAL(132, frame_bits_max(&f));
+    f.extended = true;
+    CHECK_EQUAL(128, frame_bits_unstuffed(&f));
+    CHECK_EQUAL(157, frame_bits_max(&f));
+    for (uint32_t id = 0; id < 0x800; id += 7) {
+        f = frame(id, false, false, id % 9, id);
+        CHECK(frame_bits(&f) >= frame_bits_unstuffed(&f));
+        CHECK(frame_bits(&f) <= frame_bits_max(&f));
+    }
+}
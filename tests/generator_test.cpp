@@ -0,0 +1,142 @@
+#include "CppUTest/TestHarness.h"
+#include <cstring>
+#include "../src/generator.h"
+
+TEST_GROUP (Generator) {
+    struct generator_s g;
+    struct generator_config_s c;
+    struct can_frame_s f;
+
+    void setup()
+    {
+        memset(&c, 0, sizeof(c));
+        c.id_mode = GENERATOR_ID_FIXED;
+        c.id_min = 0x123;
+        c.id_max = 0x123;
+        c.dlc_min = 8;
+        c.dlc_max = 8;
+        c.data_mode = GENERATOR_DATA_COUNTER;
+        c.load = 100;
+    }
+
+    void next_sent()
+    {
+        generator_next(&g, &f);
+        generator_sent(&g, &f);
+    }
+};
+
+TEST(Generator, FixedIdCounterPayload)
+{
+    generator_init(&g, &c, 1);
+    generator_next(&g, &f);
+    generator_next(&g, &f);
+    CHECK_EQUAL(0x123, f.id);
+    CHECK_FALSE(f.extended);
+    CHECK_FALSE(f.remote);
+    CHECK_EQUAL(8, f.length);
+    uint8_t expect[8] = {1, 0, 0, 0, 0, 0, 0, 0};
+    MEMCMP_EQUAL(expect, f.data, 8);
+}
+
+TEST(Generator, IncrementingIdWraps)
+{
+    c.id_mode = GENERATOR_ID_INCREMENT;
+    c.id_min = 0x10;
+    c.id_max = 0x12;
+    generator_init(&g, &c, 1);
+    uint32_t expect[] = {0x10, 0x11, 0x12, 0x10};
+    unsigned int i;
+    for (i = 0; i < 4; i++) {
+        generator_next(&g, &f);
+        CHECK_EQUAL(expect[i], f.id);
+    }
+}
+
+TEST(Generator, RandomIdAndDlcInRange)
+{
+    c.id_mode = GENERATOR_ID_RANDOM;
+    c.id_min = 0x100;
+    c.id_max = 0x10f;
+    c.extended = true;
+    c.dlc_min = 2;
+    c.dlc_max = 5;
+    c.data_mode = GENERATOR_DATA_RANDOM;
+    generator_init(&g, &c, 12345);
+    unsigned int i;
+    bool seen_min = false, seen_max = false;
+    for (i = 0; i < 200; i++) {
+        generator_next(&g, &f);
+        CHECK(f.id >= 0x100 && f.id <= 0x10f);
+        CHECK_TRUE(f.extended);
+        CHECK(f.length >= 2 && f.length <= 5);
+        seen_min |= f.length == 2;
+        seen_max |= f.length == 5;
+    }
+    CHECK_TRUE(seen_min);
+    CHECK_TRUE(seen_max);
+}
+
+TEST(Generator, FixedPayload)
+{
+    c.data_mode = GENERATOR_DATA_FIXED;
+    uint8_t data[8] = {0xde, 0xad, 0xbe, 0xef, 1, 2, 3, 4};
+    memcpy(c.data, data, 8);
+    generator_init(&g, &c, 1);
+    generator_next(&g, &f);
+    MEMCMP_EQUAL(data, f.data, 8);
+}
+
+TEST(Generator, FrameBits)
+{
+    memset(&f, 0, sizeof(f));
+    CHECK_EQUAL(47, generator_frame_bits(&f));
+    f.length = 8;
+    CHECK_EQUAL(111, generator_frame_bits(&f));
+    f.extended = true;
+    CHECK_EQUAL(131, generator_frame_bits(&f));
+    f.remote = true;
+    CHECK_EQUAL(67, generator_frame_bits(&f));
+}
+
+TEST(Generator, SaturatedHasNoOffset)
+{
+    generator_init(&g, &c, 1);
+    next_sent();
+    next_sent();
+    CHECK_EQUAL(0, generator_offset(&g, 500000));
+}
+
+TEST(Generator, LoadOffset)
+{
+    c.load = 50;
+    generator_init(&g, &c, 1);
+    CHECK_EQUAL(0, generator_offset(&g, 1000000));
+    next_sent();
+    // 111 bits at 1 Mbit/s and 50 % load
+    CHECK_EQUAL(222, generator_offset(&g, 1000000));
+    next_sent();
+    CHECK_EQUAL(444, generator_offset(&g, 1000000));
+}
+
+TEST(Generator, RateOffset)
+{
+    c.rate = 3000;
+    generator_init(&g, &c, 1);
+    next_sent();
+    CHECK_EQUAL(333, generator_offset(&g, 1000000));
+    next_sent();
+    CHECK_EQUAL(666, generator_offset(&g, 1000000));
+}
+
+TEST(Generator, AchievedLoad)
+{
+    generator_init(&g, &c, 1);
+    unsigned int i;
+    for (i = 0; i < 10; i++) {
+        next_sent();
+    }
+    // 1110 bits at 500 kbit/s in 4440 us
+    CHECK_EQUAL(500, generator_load(&g, 4440, 500000));
+    CHECK_EQUAL(0, generator_load(&g, 0, 500000));
+}
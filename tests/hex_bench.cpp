@@ -0,0 +1,252 @@
+/*
+ * Frame codec micro-benchmark
+ * Times frame shaped workloads with the firmware's encoder and parser,
+ * slcan_frame_to_ascii() and slcan_parse_frame() built from src/slcan.c,
+ * against the former nibble at a time code, checks that both produce the
+ * same output and fails if the firmware code is slower than the reference
+ * by more than the given ratio (default 1.25).
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../src/slcan.h"
+
+namespace {
+
+// former implementation from slcan.c
+namespace ref {
+
+char hex_digit(uint8_t b)
+{
+    static const char* hex_tbl = "0123456789abcdef";
+    return hex_tbl[b & 0x0f];
+}
+
+void hex_write(char** p, const uint8_t* data, uint8_t len)
+{
+    for (unsigned int i = 0; i < len; i++) {
+        *(*p)++ = hex_digit(data[i] >> 4);
+        *(*p)++ = hex_digit(data[i]);
+    }
+}
+
+uint8_t hex_val(char c)
+{
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 0xA;
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 0xa;
+    } else {
+        return (c - '0') & 0xf;
+    }
+}
+
+bool hex_valid(const char* str, size_t len)
+{
+    while (len-- > 0) {
+        char c = *str++;
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t hex_to_u32(const char* str, uint8_t len)
+{
+    uint32_t val = 0;
+    for (unsigned int i = 0; i < len; i++) {
+        val = (val << 4) | hex_val(str[i]);
+    }
+    return val;
+}
+
+} // namespace ref
+
+struct frame {
+    uint32_t id;
+    bool extended;
+    bool remote;
+    uint8_t length;
+    uint8_t data[8];
+};
+
+size_t encode_ref(char* buf, const frame& f)
+{
+    char* p = buf;
+    *p++ = f.remote ? (f.extended ? 'R' : 'r') : (f.extended ? 'T' : 't');
+    if (f.extended) {
+        for (int i = 3; i >= 0; i--) {
+            uint8_t b = f.id >> (8 * i);
+            ref::hex_write(&p, &b, 1);
+        }
+    } else {
+        *p++ = ref::hex_digit(f.id >> 8);
+        *p++ = ref::hex_digit(f.id >> 4);
+        *p++ = ref::hex_digit(f.id);
+    }
+    *p++ = ref::hex_digit(f.length);
+    if (!f.remote) {
+        ref::hex_write(&p, f.data, f.length);
+    }
+    *p++ = '\r';
+    return p - buf;
+}
+
+bool decode_ref(const char* line, size_t n, frame& f)
+{
+    f.extended = line[0] == 'T' || line[0] == 'R';
+    f.remote = line[0] == 'r' || line[0] == 'R';
+    size_t id_len = f.extended ? 8 : 3;
+    line++;
+    n--;
+    if (n < id_len + 1 || !ref::hex_valid(line, id_len + 1)) {
+        return false;
+    }
+    f.id = ref::hex_to_u32(line, id_len);
+    f.length = ref::hex_val(line[id_len]);
+    size_t data_len = f.remote ? 0 : 2 * f.length;
+    if (f.length > 8 || n != id_len + 1 + data_len || !ref::hex_valid(line + id_len + 1, data_len)) {
+        return false;
+    }
+    for (unsigned int i = 0; i < data_len / 2; i++) {
+        f.data[i] = ref::hex_to_u32(line + id_len + 1 + 2 * i, 2);
+    }
+    return true;
+}
+
+const int FRAMES = 64;
+const int ROUNDS = 20000;
+
+struct mix {
+    const char* name;
+    bool extended;
+    bool remote;
+    int dlc_min;
+    int dlc_max;
+};
+
+const mix mixes[] = {
+    {"standard dlc 0-8", false, false, 0, 8},
+    {"standard dlc 8", false, false, 8, 8},
+    {"extended dlc 0-8", true, false, 0, 8},
+    {"extended dlc 8", true, false, 8, 8},
+    {"standard remote", false, true, 0, 8},
+    {"extended remote", true, true, 0, 8},
+};
+
+void make_frames(const mix& m, frame* frames)
+{
+    uint32_t seed = 12345;
+    for (int i = 0; i < FRAMES; i++) {
+        seed = seed * 1103515245 + 12345;
+        frame& f = frames[i];
+        f.extended = m.extended;
+        f.remote = m.remote;
+        f.id = (seed >> 3) & (m.extended ? 0x1fffffff : 0x7ff);
+        f.length = m.dlc_min + (seed >> 24) % (m.dlc_max - m.dlc_min + 1);
+        for (int j = 0; j < 8; j++) {
+            f.data[j] = seed >> (j * 3);
+        }
+    }
+}
+
+volatile uint32_t sink;
+
+template <typename F>
+double time_ns(F fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        fn();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (ROUNDS * FRAMES);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    double max_ratio = argc > 1 ? atof(argv[1]) : 1.25;
+    static frame frames[FRAMES];
+    static can_frame_s records[FRAMES];
+    static char text[FRAMES][SLCAN_MAX_FRAME_LEN];
+    static size_t text_len[FRAMES];
+    double enc_ref_total = 0, enc_fw_total = 0, dec_ref_total = 0, dec_fw_total = 0;
+    int status = 0;
+
+    printf("%-18s %12s %12s %12s %12s\n", "ns/frame", "encode ref", "encode fw", "decode ref", "decode fw");
+    for (const mix& m : mixes) {
+        make_frames(m, frames);
+
+        for (int i = 0; i < FRAMES; i++) {
+            can_frame_s& r = records[i];
+            memset(&r, 0, sizeof(r));
+            r.id = frames[i].id;
+            r.extended = frames[i].extended;
+            r.remote = frames[i].remote;
+            r.length = frames[i].length;
+            memcpy(r.data, frames[i].data, sizeof(r.data));
+
+            char a[SLCAN_MAX_FRAME_LEN], b[SLCAN_MAX_FRAME_LEN];
+            size_t la = encode_ref(a, frames[i]);
+            size_t lb = slcan_frame_to_ascii(b, &r, SLCAN_TIMESTAMP_OFF);
+            if (la != lb || memcmp(a, b, la) != 0) {
+                printf("encode mismatch: %.*s / %.*s\n", (int)la, a, (int)lb, b);
+                return 1;
+            }
+            memcpy(text[i], b, lb + 1);
+            text_len[i] = lb - 1; // without CR
+            frame fa;
+            can_frame_s fb;
+            bool oka = decode_ref(text[i], text_len[i], fa);
+            bool okb = slcan_parse_frame(text[i], &fb);
+            if (!oka || !okb || fa.id != fb.id || fa.length != fb.length
+                || (!fa.remote && memcmp(fa.data, fb.data, fa.length) != 0)) {
+                printf("decode mismatch: %.*s\n", (int)la, a);
+                return 1;
+            }
+        }
+
+        char out[SLCAN_MAX_FRAME_LEN];
+        frame f;
+        can_frame_s cf;
+        double enc_ref = time_ns([&] {
+            for (int i = 0; i < FRAMES; i++) {
+                sink += encode_ref(out, frames[i]) + out[1];
+            }
+        });
+        double enc_fw = time_ns([&] {
+            for (int i = 0; i < FRAMES; i++) {
+                sink += slcan_frame_to_ascii(out, &records[i], SLCAN_TIMESTAMP_OFF) + out[1];
+            }
+        });
+        double dec_ref = time_ns([&] {
+            for (int i = 0; i < FRAMES; i++) {
+                sink += decode_ref(text[i], text_len[i], f) + f.id;
+            }
+        });
+        double dec_fw = time_ns([&] {
+            for (int i = 0; i < FRAMES; i++) {
+                sink += slcan_parse_frame(text[i], &cf) + cf.id;
+            }
+        });
+        printf("%-18s %12.1f %12.1f %12.1f %12.1f\n", m.name, enc_ref, enc_fw, dec_ref, dec_fw);
+        enc_ref_total += enc_ref;
+        enc_fw_total += enc_fw;
+        dec_ref_total += dec_ref;
+        dec_fw_total += dec_fw;
+    }
+
+    if (enc_fw_total > enc_ref_total * max_ratio) {
+        printf("encode regression: %.1f ns vs %.1f ns reference\n", enc_fw_total, enc_ref_total);
+        status = 1;
+    }
+    if (dec_fw_total > dec_ref_total * max_ratio) {
+        printf("decode regression: %.1f ns vs %.1f ns reference\n", dec_fw_total, dec_ref_total);
+        status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,60 @@
+#include "CppUTest/TestHarness.h"
+#include <cstring>
+#include "../src/hex.h"
+
+TEST_GROUP (Hex) {
+    char buf[32];
+
+    void setup()
+    {
+        memset(buf, 0, sizeof(buf));
+    }
+};
+
+TEST(Hex, Encode)
+{
+    const uint8_t data[] = {0x00, 0x12, 0xab, 0xff, 0x7e};
+    hex_encode(buf, data, sizeof(data));
+    STRCMP_EQUAL("0012abff7e", buf);
+}
+
+TEST(Hex, EncodeU32)
+{
+    hex_encode_u32(buf, 0x1234abcd, 8);
+    STRCMP_EQUAL("1234abcd", buf);
+    memset(buf, 0, sizeof(buf));
+    hex_encode_u32(buf, 0x72a, 3);
+    STRCMP_EQUAL("72a", buf);
+    memset(buf, 0, sizeof(buf));
+    hex_encode_u32(buf, 0xdead, 4);
+    STRCMP_EQUAL("dead", buf);
+    memset(buf, 0, sizeof(buf));
+    hex_encode_u32(buf, 0x5, 1);
+    STRCMP_EQUAL("5", buf);
+}
+
+TEST(Hex, Decode)
+{
+    uint8_t data[4];
+    const uint8_t expect[] = {0x01, 0xab, 0xcd, 0xef};
+    CHECK_TRUE(hex_decode(data, "01aBCdeF", 4));
+    MEMCMP_EQUAL(expect, data, sizeof(expect));
+    CHECK_FALSE(hex_decode(data, "01g0", 2));
+}
+
+TEST(Hex, DecodeU32)
+{
+    uint32_t val;
+    CHECK_TRUE(hex_decode_u32("1FFFffff", 8, &val));
+    CHECK_EQUAL(0x1fffffff, val);
+    CHECK_FALSE(hex_decode_u32("12 4", 4, &val));
+    CHECK_FALSE(hex_decode_u32("\r", 1, &val));
+}
+
+TEST(Hex, Valid)
+{
+    CHECK_TRUE(hex_valid("0123456789abcdefABCDEF", 22));
+    CHECK_TRUE(hex_valid("", 0));
+    CHECK_FALSE(hex_valid("0x", 2));
+    CHECK_FALSE(hex_valid("G", 1));
+}
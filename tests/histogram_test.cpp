@@ -0,0 +1,44 @@
+#include "CppUTest/TestHarness.h"
+#include "../src/histogram.h"
+
+TEST_GROUP (Histogram) {
+    struct histogram_s h;
+
+    void setup()
+    {
+        histogram_init(&h);
+    }
+};
+
+TEST(Histogram, Bins)
+{
+    CHECK_EQUAL(0, histogram_bin(0));
+    CHECK_EQUAL(1, histogram_bin(1));
+    CHECK_EQUAL(2, histogram_bin(2));
+    CHECK_EQUAL(2, histogram_bin(3));
+    CHECK_EQUAL(3, histogram_bin(4));
+    CHECK_EQUAL(10, histogram_bin(1023));
+    CHECK_EQUAL(11, histogram_bin(1024));
+    CHECK_EQUAL(HISTOGRAM_BINS - 1, histogram_bin(1 << (HISTOGRAM_BINS - 2)));
+    CHECK_EQUAL(HISTOGRAM_BINS - 1, histogram_bin(UINT32_MAX));
+}
+
+TEST(Histogram, Empty)
+{
+    CHECK_EQUAL(0, h.count);
+    CHECK_EQUAL(0, histogram_mean(&h));
+}
+
+TEST(Histogram, Statistics)
+{
+    histogram_add(&h, 10);
+    histogram_add(&h, 20);
+    histogram_add(&h, 60);
+    CHECK_EQUAL(3, h.count);
+    CHECK_EQUAL(10, h.min);
+    CHECK_EQUAL(60, h.max);
+    CHECK_EQUAL(30, histogram_mean(&h));
+    CHECK_EQUAL(1, h.bins[4]);
+    CHECK_EQUAL(1, h.bins[5]);
+    CHECK_EQUAL(1, h.bins[6]);
+}
@@ -0,0 +1,63 @@
+#include "CppUTest/TestHarness.h"
+#include <cstring>
+#include "../src/line_reader.h"
+
+TEST_GROUP (LineReader) {
+    struct line_reader_s r;
+    char* line;
+
+    void setup()
+    {
+        line_reader_init(&r);
+    }
+
+    size_t feed(const char* data)
+    {
+        return line_reader_feed(&r, data, strlen(data), &line);
+    }
+};
+
+TEST(LineReader, IncompleteLine)
+{
+    CHECK_EQUAL(4, feed("t100"));
+    POINTERS_EQUAL(NULL, line);
+}
+
+TEST(LineReader, LineSplitAcrossChunks)
+{
+    feed("t10");
+    CHECK_EQUAL(5, feed("012a\r"));
+    STRCMP_EQUAL("t10012a", line);
+}
+
+TEST(LineReader, OneLineAtATime)
+{
+    const char* data = "O\rt10012a\rC\r";
+    size_t n = feed(data);
+    CHECK_EQUAL(2, n);
+    STRCMP_EQUAL("O", line);
+    n += line_reader_feed(&r, data + n, strlen(data) - n, &line);
+    STRCMP_EQUAL("t10012a", line);
+    n += line_reader_feed(&r, data + n, strlen(data) - n, &line);
+    STRCMP_EQUAL("C", line);
+    CHECK_EQUAL(strlen(data), n);
+}
+
+TEST(LineReader, EmptyLine)
+{
+    feed("\n");
+    STRCMP_EQUAL("", line);
+}
+
+TEST(LineReader, LongLineIsDropped)
+{
+    unsigned int i;
+    for (i = 0; i < LINE_READER_SIZE; i++) {
+        feed("a");
+    }
+    // the rest of the long line is dropped with it
+    CHECK_EQUAL(4, feed("aa\rV"));
+    POINTERS_EQUAL(NULL, line);
+    feed("\r");
+    STRCMP_EQUAL("V", line);
+}
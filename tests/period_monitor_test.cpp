@@ -0,0 +1,127 @@
+#include "CppUTest/TestHarness.h"
+#include "../src/period_monitor.h"
+
+TEST_GROUP (PeriodMonitor) {
+    struct period_monitor_s m;
+    uint32_t elapsed;
+
+    void setup()
+    {
+        period_monitor_init(&m);
+        elapsed = 0;
+    }
+};
+
+TEST(PeriodMonitor, UnwatchedIdIsIgnored)
+{
+    period_monitor_watch(&m, 0x100, false, 1000);
+    POINTERS_EQUAL(NULL, period_monitor_update(&m, 0x100, true, 0, &elapsed));
+    POINTERS_EQUAL(NULL, period_monitor_update(&m, 0x100, true, 5000, &elapsed));
+    CHECK_EQUAL(0, m.entries[0].count);
+}
+
+TEST(PeriodMonitor, TableFull)
+{
+    unsigned int i;
+    for (i = 0; i < PERIOD_MONITOR_SIZE; i++) {
+        CHECK_TRUE(period_monitor_watch(&m, i, false, 1000));
+    }
+    CHECK_FALSE(period_monitor_watch(&m, 0x7ff, false, 1000));
+    // rewatching an existing ID replaces its entry
+    CHECK_TRUE(period_monitor_watch(&m, 3, false, 2000));
+    CHECK_EQUAL(2000, m.entries[3].period);
+}
+
+TEST(PeriodMonitor, IntervalStatistics)
+{
+    period_monitor_watch(&m, 0x100, false, 1000);
+    period_monitor_update(&m, 0x100, false, 10000, &elapsed);
+    period_monitor_update(&m, 0x100, false, 10990, &elapsed);
+    period_monitor_update(&m, 0x100, false, 12000, &elapsed);
+    period_monitor_update(&m, 0x100, false, 13020, &elapsed);
+    struct period_monitor_entry_s* e = &m.entries[0];
+    CHECK_EQUAL(3, e->count);
+    CHECK_EQUAL(990, e->min);
+    CHECK_EQUAL(1020, e->max);
+    CHECK_EQUAL(1006, period_monitor_mean(e));
+    CHECK_EQUAL(2, e->hist[0]); // 10us, 10us
+    CHECK_EQUAL(1, e->hist[1]); // 20us
+}
+
+TEST(PeriodMonitor, HistogramBins)
+{
+    CHECK_EQUAL(0, period_monitor_hist_bin(0));
+    CHECK_EQUAL(0, period_monitor_hist_bin(15));
+    CHECK_EQUAL(1, period_monitor_hist_bin(16));
+    CHECK_EQUAL(2, period_monitor_hist_bin(64));
+    CHECK_EQUAL(6, period_monitor_hist_bin(65535));
+    CHECK_EQUAL(PERIOD_MONITOR_HIST_BINS - 1, period_monitor_hist_bin(UINT32_MAX));
+}
+
+TEST(PeriodMonitor, LearnsPeriod)
+{
+    period_monitor_watch(&m, 0x100, false, 0);
+    uint32_t t = 0;
+    int i;
+    for (i = 0; i <= PERIOD_MONITOR_LEARN_COUNT; i++) {
+        CHECK_EQUAL(0, m.entries[0].period);
+        period_monitor_update(&m, 0x100, false, t, &elapsed);
+        t += (i % 2) ? 900 : 1100;
+    }
+    CHECK_EQUAL(1000, m.entries[0].period);
+}
+
+TEST(PeriodMonitor, NoDeadlineWhileLearning)
+{
+    period_monitor_watch(&m, 0x100, false, 0);
+    period_monitor_update(&m, 0x100, false, 0, &elapsed);
+    POINTERS_EQUAL(NULL, period_monitor_check(&m, 1000000, &elapsed));
+}
+
+TEST(PeriodMonitor, CheckReportsMissedDeadlineOnce)
+{
+    period_monitor_watch(&m, 0x100, false, 1000);
+    period_monitor_update(&m, 0x100, false, 5000, &elapsed);
+    POINTERS_EQUAL(NULL, period_monitor_check(&m, 6500, &elapsed));
+    POINTERS_EQUAL(&m.entries[0], period_monitor_check(&m, 6501, &elapsed));
+    CHECK_EQUAL(1501, elapsed);
+    POINTERS_EQUAL(NULL, period_monitor_check(&m, 9000, &elapsed));
+    CHECK_EQUAL(1, m.entries[0].missed);
+
+    // late frame was already reported
+    POINTERS_EQUAL(NULL, period_monitor_update(&m, 0x100, false, 9000, &elapsed));
+    CHECK_EQUAL(1, m.entries[0].missed);
+
+    // re-armed
+    POINTERS_EQUAL(&m.entries[0], period_monitor_check(&m, 11000, &elapsed));
+    CHECK_EQUAL(2, m.entries[0].missed);
+}
+
+TEST(PeriodMonitor, UpdateReportsLateFrame)
+{
+    period_monitor_watch(&m, 0x1234abcd, true, 1000);
+    period_monitor_update(&m, 0x1234abcd, true, 5000, &elapsed);
+    POINTERS_EQUAL(&m.entries[0], period_monitor_update(&m, 0x1234abcd, true, 7000, &elapsed));
+    CHECK_EQUAL(2000, elapsed);
+    CHECK_EQUAL(1, m.entries[0].missed);
+}
+
+TEST(PeriodMonitor, TimestampOverflow)
+{
+    period_monitor_watch(&m, 0x100, false, 1000);
+    period_monitor_update(&m, 0x100, false, UINT32_MAX - 499, &elapsed);
+    POINTERS_EQUAL(NULL, period_monitor_update(&m, 0x100, false, 500, &elapsed));
+    CHECK_EQUAL(1000, m.entries[0].max);
+}
+
+TEST(PeriodMonitor, ResetKeepsWatchedIds)
+{
+    period_monitor_watch(&m, 0x100, false, 1000);
+    period_monitor_update(&m, 0x100, false, 0, &elapsed);
+    period_monitor_update(&m, 0x100, false, 1000, &elapsed);
+    period_monitor_reset(&m);
+    CHECK_TRUE(m.entries[0].active);
+    CHECK_EQUAL(1000, m.entries[0].period);
+    CHECK_EQUAL(0, m.entries[0].count);
+    CHECK_FALSE(m.entries[0].seen);
+}
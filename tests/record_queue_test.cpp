@@ -0,0 +1,91 @@
+#include "CppUTest/TestHarness.h"
+#include <cstring>
+#include "../src/record_queue.h"
+
+TEST_GROUP (RecordQueue) {
+    struct record_queue_s q;
+    uint8_t buf[32];
+
+    void setup()
+    {
+        record_queue_init(&q, buf, sizeof(buf));
+    }
+
+    void check_front(const char* expect)
+    {
+        size_t len;
+        const void* r = record_queue_front(&q, &len);
+        CHECK(r != NULL);
+        CHECK_EQUAL(strlen(expect), len);
+        MEMCMP_EQUAL(expect, r, len);
+    }
+};
+
+TEST(RecordQueue, Empty)
+{
+    size_t len;
+    CHECK_TRUE(record_queue_empty(&q));
+    POINTERS_EQUAL(NULL, record_queue_front(&q, &len));
+}
+
+TEST(RecordQueue, RecordsComeOutWhole)
+{
+    CHECK_TRUE(record_queue_push(&q, "t1230\r", 6));
+    CHECK_TRUE(record_queue_push(&q, "\r", 1));
+    check_front("t1230\r");
+    record_queue_pop(&q);
+    check_front("\r");
+    record_queue_pop(&q);
+    CHECK_TRUE(record_queue_empty(&q));
+}
+
+TEST(RecordQueue, PushFailsWhenFull)
+{
+    // 2 byte length prefix per record, padded to 2 bytes
+    CHECK_TRUE(record_queue_push(&q, "0123456789abcd", 14));
+    CHECK_TRUE(record_queue_push(&q, "0123456789", 10));
+    CHECK_FALSE(record_queue_push(&q, "012", 3));
+    CHECK_TRUE(record_queue_push(&q, "01", 2));
+    CHECK_FALSE(record_queue_push(&q, "0", 1));
+    record_queue_pop(&q);
+    CHECK_TRUE(record_queue_push(&q, "0", 1));
+}
+
+TEST(RecordQueue, RecordDoesNotWrap)
+{
+    const char* r = "t1230\r";
+    CHECK_TRUE(record_queue_push(&q, "0123456789abcd", 14));
+    CHECK_TRUE(record_queue_push(&q, "0123456789", 10));
+    record_queue_pop(&q);
+    // 4 bytes left at the end, the record goes to the start
+    CHECK_TRUE(record_queue_push(&q, r, strlen(r)));
+    check_front("0123456789");
+    record_queue_pop(&q);
+    check_front(r);
+    size_t len;
+    POINTERS_EQUAL(buf + 2, record_queue_front(&q, &len));
+}
+
+TEST(RecordQueue, NoRoomAfterSkippingTheEnd)
+{
+    CHECK_TRUE(record_queue_push(&q, "0123456789", 10));
+    CHECK_TRUE(record_queue_push(&q, "01", 2));
+    // 16 bytes at the end, 12 used at the start
+    CHECK_FALSE(record_queue_push(&q, "0123456789abcdef", 16));
+    check_front("0123456789");
+}
+
+TEST(RecordQueue, EncodeInPlace)
+{
+    char* p = (char*)record_queue_reserve(&q, 16);
+    CHECK(p != NULL);
+    strcpy(p, "t10012a\r");
+    record_queue_commit(&q, strlen(p));
+    check_front("t10012a\r");
+}
+
+TEST(RecordQueue, EmptyRecordIsRejected)
+{
+    CHECK_FALSE(record_queue_push(&q, "", 0));
+    CHECK_TRUE(record_queue_empty(&q));
+}
@@ -0,0 +1,220 @@
+#include "CppUTest/TestHarness.h"
+#include <cstring>
+#include "../src/replay.h"
+
+static struct can_frame_s make_frame(uint32_t id)
+{
+    struct can_frame_s f;
+    memset(&f, 0, sizeof(f));
+    f.id = id;
+    f.length = 1;
+    f.data[0] = id;
+    return f;
+}
+
+TEST_GROUP (Replay) {
+    struct replay_s r;
+    unsigned int seq;
+
+    void setup()
+    {
+        replay_init(&r);
+    }
+
+    void add(uint32_t id, uint32_t offset)
+    {
+        struct can_frame_s f = make_frame(id);
+        CHECK_TRUE(replay_add(&r, &f, offset));
+    }
+};
+
+TEST(Replay, StartEmptyFails)
+{
+    CHECK_FALSE(replay_start(&r, 100, 1, 0));
+    uint32_t deadline;
+    POINTERS_EQUAL(NULL, replay_next(&r, &seq, &deadline));
+}
+
+TEST(Replay, AddRejectsDecreasingOffset)
+{
+    add(1, 1000);
+    struct can_frame_s f = make_frame(2);
+    CHECK_FALSE(replay_add(&r, &f, 999));
+    CHECK_EQUAL(1, r.count);
+}
+
+TEST(Replay, AddRejectsWhenFull)
+{
+    unsigned int i;
+    for (i = 0; i < REPLAY_SIZE; i++) {
+        add(i, i);
+    }
+    struct can_frame_s f = make_frame(0);
+    CHECK_FALSE(replay_add(&r, &f, REPLAY_SIZE));
+}
+
+TEST(Replay, DurationFromMeanSpacing)
+{
+    add(1, 0);
+    add(2, 1000);
+    add(3, 2000);
+    CHECK_EQUAL(3000, replay_duration(&r));
+    r.duration = 5000;
+    CHECK_EQUAL(5000, replay_duration(&r));
+}
+
+TEST(Replay, SingleRunSchedule)
+{
+    add(1, 0);
+    add(2, 1000);
+    CHECK_TRUE(replay_start(&r, 100, 1, 500));
+
+    uint32_t deadline;
+    const struct can_frame_s* f = replay_next(&r, &seq, &deadline);
+    CHECK_EQUAL(1, f->id);
+    CHECK_EQUAL(500, deadline);
+    replay_sent(&r, 510);
+
+    f = replay_next(&r, &seq, &deadline);
+    CHECK_EQUAL(2, f->id);
+    CHECK_EQUAL(1500, deadline);
+    replay_sent(&r, 1495);
+
+    POINTERS_EQUAL(NULL, replay_next(&r, &seq, &deadline));
+    CHECK_EQUAL(REPLAY_IDLE, r.state);
+    CHECK_EQUAL(10, r.error[0]);
+    CHECK_EQUAL(-5, r.error[1]);
+}
+
+TEST(Replay, SpeedScalesOffsets)
+{
+    add(1, 0);
+    add(2, 1000);
+    CHECK_TRUE(replay_start(&r, 200, 1, 0));
+
+    uint32_t deadline;
+    replay_next(&r, &seq, &deadline);
+    replay_sent(&r, 0);
+    replay_next(&r, &seq, &deadline);
+    CHECK_EQUAL(500, deadline);
+}
+
+TEST(Replay, LoopsAdvanceByDuration)
+{
+    add(1, 0);
+    add(2, 1000);
+    CHECK_TRUE(replay_start(&r, 100, 0, 0));
+
+    uint32_t deadline;
+    unsigned int i;
+    for (i = 0; i < 6; i++) {
+        CHECK(replay_next(&r, &seq, &deadline) != NULL);
+        replay_sent(&r, deadline);
+    }
+    CHECK_EQUAL(3, r.loop);
+    replay_next(&r, &seq, &deadline);
+    CHECK_EQUAL(6000, deadline);
+    CHECK_EQUAL(REPLAY_RUNNING, r.state);
+
+    replay_stop(&r);
+    POINTERS_EQUAL(NULL, replay_next(&r, &seq, &deadline));
+}
+
+TEST(Replay, DeadlineWrapsAround)
+{
+    add(1, 0);
+    add(2, 100);
+    CHECK_TRUE(replay_start(&r, 100, 1, 0xffffffc0));
+
+    uint32_t deadline;
+    replay_next(&r, &seq, &deadline);
+    replay_sent(&r, 0xffffffc0);
+    replay_next(&r, &seq, &deadline);
+    CHECK_EQUAL(0x24, deadline);
+    replay_sent(&r, 0x26);
+    CHECK_EQUAL(2, r.error[1]);
+}
+
+TEST(Replay, SingleRunRefillsWhileRunning)
+{
+    unsigned int i;
+    for (i = 0; i < REPLAY_SIZE; i++) {
+        add(i, i * 100);
+    }
+    CHECK_TRUE(replay_start(&r, 100, 1, 0));
+
+    // full and nothing sent yet
+    struct can_frame_s f = make_frame(REPLAY_SIZE);
+    CHECK_FALSE(replay_add(&r, &f, REPLAY_SIZE * 100));
+
+    uint32_t deadline;
+    replay_next(&r, &seq, &deadline);
+    replay_sent(&r, deadline + 3);
+    add(REPLAY_SIZE, REPLAY_SIZE * 100);
+    CHECK_EQUAL(1, r.first);
+    CHECK_EQUAL(REPLAY_SIZE, r.count);
+
+    for (i = 1; i <= REPLAY_SIZE; i++) {
+        const struct can_frame_s* fp = replay_next(&r, &seq, &deadline);
+        CHECK_EQUAL(i, fp->id);
+        CHECK_EQUAL(i * 100, deadline);
+        replay_sent(&r, deadline);
+    }
+    POINTERS_EQUAL(NULL, replay_next(&r, &seq, &deadline));
+
+    int32_t error;
+    CHECK_TRUE(replay_error(&r, REPLAY_SIZE - 1, &error));
+    CHECK_FALSE(replay_error(&r, REPLAY_SIZE, &error));
+}
+
+TEST(Replay, LoopingTraceRefusesAddWhileRunning)
+{
+    add(1, 0);
+    CHECK_TRUE(replay_start(&r, 100, 0, 0));
+    struct can_frame_s f = make_frame(2);
+    CHECK_FALSE(replay_add(&r, &f, 100));
+    replay_stop(&r);
+    CHECK_TRUE(replay_add(&r, &f, 100));
+}
+
+TEST(Replay, ErrorFromStartOfFrame)
+{
+    add(1, 0);
+    add(2, 1000);
+    CHECK_TRUE(replay_start(&r, 100, 1, 500));
+
+    uint32_t deadline;
+    replay_next(&r, &seq, &deadline);
+    CHECK_EQUAL(0, seq);
+    replay_sent(&r, 505);
+    CHECK_EQUAL(5, r.error[0]);
+    // waited behind other frames on the bus
+    replay_done(&r, 0, 740);
+    CHECK_EQUAL(240, r.error[0]);
+
+    replay_next(&r, &seq, &deadline);
+    CHECK_EQUAL(1, seq);
+    replay_sent(&r, 1500);
+    replay_done(&r, 1, 1510);
+    CHECK_EQUAL(10, r.error[1]);
+}
+
+TEST(Replay, DoneAfterLoopUsesPreviousRun)
+{
+    add(1, 0);
+    add(2, 1000);
+    CHECK_TRUE(replay_start(&r, 100, 0, 0));
+
+    uint32_t deadline;
+    replay_next(&r, &seq, &deadline);
+    replay_sent(&r, deadline);
+    replay_next(&r, &seq, &deadline);
+    replay_sent(&r, deadline);
+    // the second frame is done once the next run started
+    replay_done(&r, 1, 1020);
+    CHECK_EQUAL(20, r.error[1]);
+    replay_next(&r, &seq, &deadline);
+    replay_sent(&r, deadline);
+    replay_done(&r, 0, 2003);
+    CHECK_EQUAL(3, r.error[0]);
+}
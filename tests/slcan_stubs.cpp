@@ -0,0 +1,383 @@
+#include "CppUTestExt/MockSupport.h"
+#include <cstring>
+#include "../src/slcan.h"
+#include "../src/can_driver.h"
+#include "../src/bus_power.h"
+#include "../src/capture.h"
+#include "../src/replay_thread.h"
+#include "../src/generator_thread.h"
+#include "../src/usb_sof.h"
+#include "../src/latency.h"
+#include "../src/cpu_load.h"
+#include "../src/trace.h"
+
+/* Stubs of the firmware around slcan.c, shared by the tests and the
+ * benchmark. The mocked calls only occur in the tests. */
+
+extern "C" {
+
+const char* software_version_str = "software version str";
+const char* hardware_version_str = "hardware version str";
+
+bool can_send(uint32_t id, bool extended, bool remote, uint8_t* data, size_t length)
+{
+    size_t data_length = remote ? 0 : length;
+    mock().actualCall("can_send").withParameter("id", id).withParameter("extended", extended).withParameter("remote", remote).withMemoryBufferParameter("data", data, data_length).withParameter("length", length);
+    return true;
+}
+
+bool can_send_timed(uint32_t id, bool extended, bool remote, uint8_t* data, size_t length, uint32_t start)
+{
+    (void)start;
+    return can_send(id, extended, remote, data, length);
+}
+
+bool can_set_bitrate(uint32_t bitrate)
+{
+    mock().actualCall("can_set_bitrate").withParameter("bitrate", bitrate);
+    return true;
+}
+
+bool can_open(int mode)
+{
+    mock().actualCall("can_open").withParameter("mode", mode);
+    return true;
+}
+
+void can_close(void)
+{
+    mock().actualCall("can_close");
+}
+
+/* dummy functions */
+
+int slcan_serial_write(void* arg, const char* buf, size_t len)
+{
+    (void)arg;
+    (void)buf;
+    (void)len;
+    return 0;
+}
+
+char* slcan_serial_reserve(void* arg, size_t len)
+{
+    static char buf[SLCAN_MAX_FRAME_LEN];
+    (void)arg;
+    (void)len;
+    return buf;
+}
+
+void slcan_serial_commit(void* arg, size_t len, uint32_t start)
+{
+    (void)arg;
+    (void)len;
+    (void)start;
+}
+
+struct can_frame_s* can_receive(void)
+{
+    return NULL;
+}
+
+void can_frame_delete(struct can_frame_s* f)
+{
+    (void)f;
+}
+
+char* slcan_getline(void* arg)
+{
+    (void)arg;
+    return NULL;
+}
+
+bool slcan_host_ready(void* arg)
+{
+    (void)arg;
+    return true;
+}
+
+bool can_monitor_watch(uint32_t id, bool extended, uint32_t period)
+{
+    mock().actualCall("can_monitor_watch").withParameter("id", id).withParameter("extended", extended).withParameter("period", period);
+    return true;
+}
+
+void can_monitor_clear(void)
+{
+    mock().actualCall("can_monitor_clear");
+}
+
+void can_monitor_reset(void)
+{
+    mock().actualCall("can_monitor_reset");
+}
+
+bool can_monitor_get(unsigned int i, struct period_monitor_entry_s* e)
+{
+    mock().actualCall("can_monitor_get").withParameter("i", i);
+    memset(e, 0, sizeof(*e));
+    if (i != 1) {
+        return false;
+    }
+    e->id = 0x123;
+    e->active = true;
+    e->period = 10000;
+    e->count = 3;
+    e->min = 9984;
+    e->max = 10016;
+    e->sum = 30000;
+    e->missed = 1;
+    e->hist[0] = 3;
+    e->hist[PERIOD_MONITOR_HIST_BINS - 1] = 0xffff;
+    return true;
+}
+
+bool can_capture_arm(const struct capture_trigger_s* t, unsigned int pre, unsigned int post)
+{
+    if (t->type != CAPTURE_TRIGGER_FRAME) {
+        mock().actualCall("can_capture_arm").withParameter("type", t->type);
+        return true;
+    }
+    if (t->length == 0) {
+        mock().actualCall("can_capture_arm").withParameter("type", t->type).withParameter("id", t->id).withParameter("mask", t->mask).withParameter("extended", t->extended).withParameter("length", t->length).withParameter("pre", pre).withParameter("post", post);
+    } else {
+        mock().actualCall("can_capture_arm").withParameter("type", t->type).withParameter("id", t->id).withParameter("mask", t->mask).withParameter("extended", t->extended).withParameter("length", t->length).withMemoryBufferParameter("data", t->data, t->length).withMemoryBufferParameter("data_mask", t->data_mask, t->length).withParameter("pre", pre).withParameter("post", post);
+    }
+    return true;
+}
+
+void can_capture_freeze(void)
+{
+    mock().actualCall("can_capture_freeze");
+}
+
+int can_capture_state(unsigned int* count)
+{
+    *count = CAPTURE_SIZE;
+    return CAPTURE_DONE;
+}
+
+bool can_capture_get(unsigned int i, struct can_frame_s* f)
+{
+    (void)i;
+    (void)f;
+    return false;
+}
+
+void can_replay_clear(void)
+{
+    mock().actualCall("can_replay_clear");
+}
+
+bool can_replay_add(const struct can_frame_s* f, uint32_t offset)
+{
+    size_t data_length = f->remote ? 0 : f->length;
+    mock().actualCall("can_replay_add").withParameter("offset", offset).withParameter("id", f->id).withParameter("extended", f->extended).withParameter("remote", f->remote).withParameter("length", f->length).withMemoryBufferParameter("data", f->remote ? NULL : f->data, data_length);
+    return true;
+}
+
+void can_replay_set_duration(uint32_t duration)
+{
+    mock().actualCall("can_replay_set_duration").withParameter("duration", duration);
+}
+
+bool can_replay_start(unsigned int speed, unsigned int loops)
+{
+    mock().actualCall("can_replay_start").withParameter("speed", speed).withParameter("loops", loops);
+    return true;
+}
+
+void can_replay_stop(void)
+{
+    mock().actualCall("can_replay_stop");
+}
+
+int can_replay_state(unsigned int* count, unsigned int* next, unsigned int* loop)
+{
+    *count = 0x20;
+    *next = 5;
+    *loop = 10;
+    return 1;
+}
+
+bool can_replay_error(unsigned int i, int32_t* error)
+{
+    (void)i;
+    (void)error;
+    return false;
+}
+
+bool can_generator_start(const struct generator_config_s* c)
+{
+    mock().actualCall("can_generator_start").withParameter("id_mode", c->id_mode).withParameter("id_min", c->id_min).withParameter("id_max", c->id_max).withParameter("extended", c->extended).withParameter("dlc_min", c->dlc_min).withParameter("dlc_max", c->dlc_max).withParameter("data_mode", c->data_mode).withParameter("rate", c->rate).withParameter("load", c->load);
+    return true;
+}
+
+void can_generator_stop(void)
+{
+    mock().actualCall("can_generator_stop");
+}
+
+void can_generator_stats(struct can_generator_stats_s* s)
+{
+    s->running = true;
+    s->sent = 0x1234;
+    s->load = 900;
+    s->timeouts = 2;
+    s->failed = 3;
+    s->bus_errors = 4;
+}
+
+bool can_bench_run(uint32_t duration, struct can_bench_s* result)
+{
+    mock().actualCall("can_bench_run").withParameter("duration", duration);
+    memset(result, 0, sizeof(*result));
+    histogram_init(&result->latency);
+    result->sent = 10000;
+    result->received = 9900;
+    result->elapsed = 990000;
+    result->busy = 9900 * 1440;
+    result->queue_high_water = 10;
+    histogram_add(&result->latency, 0x70);
+    histogram_add(&result->latency, 0x90);
+    histogram_add(&result->latency, 0x120);
+    return true;
+}
+
+void can_bench_get(struct can_bench_s* result)
+{
+    memset(result, 0, sizeof(*result));
+}
+
+uint32_t can_frame_time(const struct can_frame_s* f)
+{
+    (void)f;
+    return 0;
+}
+
+uint32_t latency_now(void)
+{
+    return 0;
+}
+
+void latency_add(unsigned int stage, uint32_t start)
+{
+    (void)stage;
+    (void)start;
+}
+
+void latency_get(unsigned int stage, struct histogram_s* h)
+{
+    (void)stage;
+    histogram_init(h);
+}
+
+void latency_reset(void)
+{
+    mock().actualCall("latency_reset");
+}
+
+void can_stats_get(struct can_stats_s* s)
+{
+    s->rx_frames = 0x100;
+    s->tx_frames = 0x20;
+    s->rx_dropped = 3;
+    s->fifo_overruns = 4;
+    s->bus_errors = 6;
+    s->queue_high_water = 30;
+    s->pool_high_water = 32;
+    s->queue_size = 500;
+}
+
+void can_stats_reset(void)
+{
+    mock().actualCall("can_stats_reset");
+}
+
+void can_status_set_period(uint32_t period)
+{
+    mock().actualCall("can_status_set_period").withParameter("period", period);
+}
+
+void can_tx_credit_enable(bool enable)
+{
+    mock().actualCall("can_tx_credit_enable").withParameter("enable", enable);
+}
+
+void slcan_serial_stats(uint32_t* written, uint32_t* timeouts)
+{
+    *written = 0xabcd;
+    *timeouts = 5;
+}
+
+void slcan_serial_stats_reset(void)
+{
+    mock().actualCall("slcan_serial_stats_reset");
+}
+
+bool cpu_thread_info(unsigned int i, struct cpu_thread_info_s* info)
+{
+    (void)i;
+    (void)info;
+    return false;
+}
+
+bool cpu_isr_info(unsigned int i, struct cpu_isr_info_s* info)
+{
+    (void)i;
+    (void)info;
+    return false;
+}
+
+void cpu_load_reset(void)
+{
+    mock().actualCall("cpu_load_reset");
+}
+
+void trace_event(uint8_t event, uint16_t arg)
+{
+    (void)event;
+    (void)arg;
+}
+
+void trace_start(void)
+{
+    mock().actualCall("trace_start");
+}
+
+void trace_stop(void)
+{
+    mock().actualCall("trace_stop");
+}
+
+void trace_stop_on_drop(bool enable)
+{
+    mock().actualCall("trace_stop_on_drop").withParameter("enable", enable);
+}
+
+size_t trace_dump(int (*write)(void* arg, const char* buf, size_t len), void* arg)
+{
+    (void)write;
+    (void)arg;
+    return 0;
+}
+
+size_t trace_dump_size(void)
+{
+    return 0;
+}
+
+bool usb_sof_get(struct usb_sof_s* s)
+{
+    s->frame = 0x7ff;
+    s->time = 0x1234567890ULL;
+    s->now = 0x12345678aULL;
+    return mock().actualCall("usb_sof_get").returnBoolValueOrDefault(true);
+}
+
+bool bus_power(bool enable)
+{
+    mock().actualCall("bus_power").withParameter("enable", enable);
+    return true;
+}
+}
@@ -1,14 +1,21 @@
 #include "CppUTest/TestHarness.h"
 #include "CppUTestExt/MockSupport.h"
 #include "CppUTest/CommandLineTestRunner.h"
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include "../src/slcan.h"
 #include "../src/can_driver.h"
 #include "../src/bus_power.h"
+#include "../src/capture.h"
+#include "../src/replay_thread.h"
+#include "../src/generator_thread.h"
+#include "../src/usb_sof.h"
 
 extern "C" {
 #include <stdint.h>
-size_t slcan_frame_to_ascii(char* buf, const struct can_frame_s* f, bool timestamp);
+size_t slcan_frame_to_ascii(char* buf, const struct can_frame_s* f, unsigned int timestamp);
+size_t slcan_record_to_ascii(char* buf, const struct can_frame_s* f);
 void slcan_send_frame(char* line);
 void slcan_decode_line(char* line);
 }
@@ -28,13 +35,19 @@ TEST_GROUP (SlcanTestGroup) {
     }
 };
 
+TEST(SlcanTestGroup, FrameRecordIs16Bytes)
+{
+    CHECK_EQUAL(16, sizeof(struct can_frame_s));
+}
+
 TEST(SlcanTestGroup, CanEncodeStandardFrame)
 {
     struct can_frame_s frame = {
-        .timestamp = 0,
         .id = 0x72a,
         .extended = false,
         .remote = false,
+        .event = false,
+        .timestamp = 0,
         .length = 4,
         .data = {0x12, 0x89, 0xab, 0xef}};
     size_t len = slcan_frame_to_ascii(line, &frame, false);
@@ -46,10 +59,11 @@ TEST(SlcanTestGroup, CanEncodeStandardFrame)
 TEST(SlcanTestGroup, CanEncodeExtendedFrame)
 {
     struct can_frame_s frame = {
-        .timestamp = 0,
         .id = 0x1234abcd,
         .extended = true,
         .remote = false,
+        .event = false,
+        .timestamp = 0,
         .length = 8,
         .data = {0, 1, 2, 3, 4, 5, 6, 7}};
     size_t len = slcan_frame_to_ascii(line, &frame, false);
@@ -61,10 +75,11 @@ TEST(SlcanTestGroup, CanEncodeExtendedFrame)
 TEST(SlcanTestGroup, CanEncodeStandardRemoteFrame)
 {
     struct can_frame_s frame = {
-        .timestamp = 0,
         .id = 0x72a,
         .extended = false,
         .remote = true,
+        .event = false,
+        .timestamp = 0,
         .length = 8,
         .data = {0}};
     size_t len = slcan_frame_to_ascii(line, &frame, false);
@@ -76,10 +91,11 @@ TEST(SlcanTestGroup, CanEncodeStandardRemoteFrame)
 TEST(SlcanTestGroup, CanEncodeExtendedRemoteFrame)
 {
     struct can_frame_s frame = {
-        .timestamp = 0,
         .id = 0x1234abcd,
         .extended = true,
         .remote = true,
+        .event = false,
+        .timestamp = 0,
         .length = 4,
         .data = {0}};
     size_t len = slcan_frame_to_ascii(line, &frame, false);
@@ -91,19 +107,67 @@ TEST(SlcanTestGroup, CanEncodeExtendedRemoteFrame)
 TEST(SlcanTestGroup, CanEncodeFrameWithTimestamp)
 {
     struct can_frame_s frame = {
-        .timestamp = 0xdead,
         .id = 0x100,
         .extended = false,
         .remote = false,
+        .event = false,
+        .timestamp = 0xdead * 1000,
         .length = 1,
-        .data = {0x2a},
-    };
+        .data = {0x2a}};
     size_t len = slcan_frame_to_ascii(line, &frame, true);
     const char* expect = "t10012adead\r";
     STRCMP_EQUAL(expect, line);
     CHECK_EQUAL(strlen(expect), len);
 }
 
+TEST(SlcanTestGroup, TimestampFormat)
+{
+    struct can_frame_s frame = {
+        .id = 0x100,
+        .extended = false,
+        .remote = false,
+        .event = false,
+        .timestamp = 0x3e7fc18,
+        .length = 1,
+        .data = {0x2a}};
+    struct can_frame_s event = {
+        .id = CAN_EVENT_CAPTURE_DONE,
+        .extended = false,
+        .remote = false,
+        .event = true,
+        .timestamp = 1234,
+        .length = 2,
+        .data = {0x00, 0x10}};
+    char buf[SLCAN_MAX_FRAME_LEN];
+
+    slcan_record_to_ascii(buf, &frame);
+    STRCMP_EQUAL("t10012a\r", buf);
+
+    strcpy(line, "Z1\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    slcan_record_to_ascii(buf, &frame);
+    STRCMP_EQUAL("t10012affff\r", buf);
+
+    strcpy(line, "Z2\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    slcan_record_to_ascii(buf, &frame);
+    STRCMP_EQUAL("t10012a03e7fc18\r", buf);
+    slcan_record_to_ascii(buf, &event);
+    STRCMP_EQUAL("E030010000004d2\r", buf);
+
+    strcpy(line, "Z3\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
+
+    strcpy(line, "Z0\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    slcan_record_to_ascii(buf, &frame);
+    STRCMP_EQUAL("t10012a\r", buf);
+}
+
 TEST(SlcanTestGroup, CanDecodeStandardFrame)
 {
     uint8_t data[] = {0x2a};
@@ -148,6 +212,25 @@ TEST(SlcanTestGroup, CanDecodeStandardRemoteFrame)
     STRCMP_EQUAL("\r", line);
 }
 
+TEST(SlcanTestGroup, CanDecodeRejectsMalformedFrames)
+{
+    const char* frames[] = {
+        "t1001\r", // missing data
+        "t10012a3\r", // trailing digit
+        "t10g12a\r", // bad ID digit
+        "t10012x\r", // bad data digit
+        "t1009\r", // DLC out of range
+        "t800\r", // standard ID out of range
+        "T200000000\r", // extended ID out of range
+        "t10\r", // truncated ID
+    };
+    for (const char* f : frames) {
+        strcpy(line, f);
+        slcan_send_frame(line);
+        STRCMP_EQUAL("\a", line);
+    }
+}
+
 TEST(SlcanTestGroup, OpenCommand)
 {
     mock().expectOneCall("can_open").withParameter("mode", CAN_MODE_NORMAL);
@@ -218,70 +301,493 @@ TEST(SlcanTestGroup, PowerOffBusCommand)
     STRCMP_EQUAL("\r", line);
 }
 
-int main(int ac, char** av)
+TEST(SlcanTestGroup, MonitorWatchStandardId)
 {
-    return CommandLineTestRunner::RunAllTests(ac, av);
+    mock().expectOneCall("can_monitor_watch").withParameter("id", 0x123).withParameter("extended", false).withParameter("period", 10000);
+    strcpy(line, "Dt12300002710\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
 }
 
-// mocks
-extern "C" {
+TEST(SlcanTestGroup, MonitorLearnExtendedId)
+{
+    mock().expectOneCall("can_monitor_watch").withParameter("id", 0x1234abcd).withParameter("extended", true).withParameter("period", 0);
+    strcpy(line, "DT1234abcd\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+}
+
+TEST(SlcanTestGroup, MonitorWatchBadLength)
+{
+    strcpy(line, "Dt12\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
+}
+
+TEST(SlcanTestGroup, MonitorStatistics)
+{
+    mock().expectOneCall("can_monitor_get").withParameter("i", 1);
+    strcpy(line, "Ds1\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("t12300002710"
+                 "00000003" // count
+                 "00002700" // min
+                 "00002710" // mean
+                 "00002720" // max
+                 "00000001" // missed
+                 "0003000000000000000000000000ffff\r",
+                 line);
+}
+
+TEST(SlcanTestGroup, MonitorStatisticsUnusedEntry)
+{
+    mock().expectOneCall("can_monitor_get").withParameter("i", 2);
+    strcpy(line, "Ds2\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
+}
+
+TEST(SlcanTestGroup, MonitorReset)
+{
+    mock().expectOneCall("can_monitor_reset");
+    strcpy(line, "Dr\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+}
 
-const char* software_version_str = "software version str";
-const char* hardware_version_str = "hardware version str";
+TEST(SlcanTestGroup, MonitorClear)
+{
+    mock().expectOneCall("can_monitor_clear");
+    strcpy(line, "Dc\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+}
 
-bool can_send(uint32_t id, bool extended, bool remote, uint8_t* data, size_t length)
+TEST(SlcanTestGroup, CanEncodeOutageEvent)
 {
-    size_t data_length = remote ? 0 : length;
-    mock().actualCall("can_send").withParameter("id", id).withParameter("extended", extended).withParameter("remote", remote).withMemoryBufferParameter("data", data, data_length).withParameter("length", length);
-    return true;
+    struct can_frame_s frame = {
+        .id = CAN_EVENT_HOST_OUTAGE,
+        .extended = false,
+        .remote = false,
+        .event = true,
+        .timestamp = 0x1000 * 1000,
+        .length = 8,
+        .data = {0, 0, 0x10, 0, 0, 0, 0x0b, 0xb8}};
+    size_t len = slcan_frame_to_ascii(line, &frame, true);
+    const char* expect = "E050000100000000bb81000\r";
+    STRCMP_EQUAL(expect, line);
+    CHECK_EQUAL(strlen(expect), len);
 }
 
-bool can_set_bitrate(uint32_t bitrate)
+TEST(SlcanTestGroup, CanEncodeEvent)
 {
-    mock().actualCall("can_set_bitrate").withParameter("bitrate", bitrate);
-    return true;
+    struct can_frame_s frame = {
+        .id = CAN_EVENT_DEADLINE_MISS,
+        .extended = false,
+        .remote = false,
+        .event = true,
+        .timestamp = 0,
+        .length = 8,
+        .data = {0x80, 0, 0x01, 0x23, 0, 0, 0x3a, 0x98}};
+    size_t len = slcan_frame_to_ascii(line, &frame, false);
+    const char* expect = "E01800001230000" "3a98\r";
+    STRCMP_EQUAL(expect, line);
+    CHECK_EQUAL(strlen(expect), len);
 }
 
-bool can_open(int mode)
+TEST(SlcanTestGroup, CaptureArmOnStandardId)
 {
-    mock().actualCall("can_open").withParameter("mode", mode);
-    return true;
+    mock().expectOneCall("can_capture_arm").withParameter("type", CAPTURE_TRIGGER_FRAME).withParameter("id", 0x120).withParameter("mask", 0x7f0).withParameter("extended", false).withParameter("length", 0).withParameter("pre", CAPTURE_SIZE / 2).withParameter("post", CAPTURE_SIZE / 2 - 1);
+    strcpy(line, "Kt1207f0\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
 }
 
-void can_close(void)
+TEST(SlcanTestGroup, CaptureArmOnExtendedIdWithPayload)
 {
-    mock().actualCall("can_close");
+    uint8_t data[] = {0xa0, 0x01};
+    uint8_t mask[] = {0xf0, 0xff};
+    mock().expectOneCall("can_capture_arm").withParameter("type", CAPTURE_TRIGGER_FRAME).withParameter("id", 0x1234abcd).withParameter("mask", 0x1fffffff).withParameter("extended", true).withParameter("length", 2).withMemoryBufferParameter("data", data, 2).withMemoryBufferParameter("data_mask", mask, 2).withParameter("pre", 4).withParameter("post", 16);
+    strcpy(line, "Kw00040010\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    strcpy(line, "KT1234abcd1fffffffa001f0ff\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+
+    // restore default window
+    strcpy(line, "Kw0020001f\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
 }
 
-/* dummy functions */
+TEST(SlcanTestGroup, CaptureWindowTooLarge)
+{
+    strcpy(line, "Kw00200020\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
+}
+
+// every numeric field is validated, garbage isn't taken as 0
+TEST(SlcanTestGroup, CommandsRejectInvalidHex)
+{
+    const char* lines[] = {
+        "Dt12x\r",
+        "Dt1230000000g\r",
+        "Dsz\r",
+        "Kw000400x0\r",
+        "Kt1207fz\r",
+        "Kt1207f0a0z1f0ff\r",
+        "Ya0000000xt1230\r",
+        "Yd0000000z\r",
+        "Ys00z4\r",
+        "Gf12g\r",
+        "Gi12012z\r",
+        "Gd1x\r",
+        "Gpf00112233445566zz\r",
+        "Glz0\r",
+        "Gh0000000z\r",
+        "Br00z8\r",
+        "Ip00z0\r",
+    };
+    unsigned int i;
+    for (i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+        strcpy(line, lines[i]);
+        slcan_decode_line(line);
+        STRCMP_EQUAL("\a", line);
+    }
+}
 
-int slcan_serial_write(void* arg, const char* buf, size_t len)
+TEST(SlcanTestGroup, CaptureBadPayloadLength)
 {
-    (void)arg;
-    (void)buf;
-    (void)len;
-    return 0;
+    strcpy(line, "Kt1207f0a0\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
 }
 
-struct can_frame_s* can_receive(void)
+TEST(SlcanTestGroup, CaptureArmOnBusOff)
 {
-    return NULL;
+    mock().expectOneCall("can_capture_arm").withParameter("type", CAPTURE_TRIGGER_BUS_OFF);
+    strcpy(line, "Kb\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
 }
 
-void can_frame_delete(struct can_frame_s* f)
+TEST(SlcanTestGroup, CaptureState)
 {
-    (void)f;
+    strcpy(line, "Ks\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("30040\r", line);
 }
 
-char* slcan_getline(void* arg)
+TEST(SlcanTestGroup, CaptureFreeze)
 {
-    (void)arg;
-    return NULL;
+    mock().expectOneCall("can_capture_freeze");
+    strcpy(line, "Kf\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
 }
 
-bool bus_power(bool enable)
+TEST(SlcanTestGroup, ReplayAddFrame)
 {
-    mock().actualCall("bus_power").withParameter("enable", enable);
-    return true;
+    uint8_t data[] = {0x12, 0x34};
+    mock().expectOneCall("can_replay_add").withParameter("offset", 0x1000).withParameter("id", 0x123).withParameter("extended", false).withParameter("remote", false).withParameter("length", 2).withMemoryBufferParameter("data", data, 2);
+    strcpy(line, "Ya00001000t12321234\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
 }
+
+TEST(SlcanTestGroup, ReplayAddExtendedRemote)
+{
+    mock().expectOneCall("can_replay_add").withParameter("offset", 0xa).withParameter("id", 0x1234abcd).withParameter("extended", true).withParameter("remote", true).withParameter("length", 8).withMemoryBufferParameter("data", NULL, 0);
+    strcpy(line, "Ya0000000aR1234abcd8\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+}
+
+TEST(SlcanTestGroup, ReplayAddInvalid)
+{
+    strcpy(line, "Ya0000t12321234\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
+    strcpy(line, "Ya00001000x12321234\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
+}
+
+TEST(SlcanTestGroup, ReplayStart)
+{
+    mock().expectOneCall("can_replay_start").withParameter("speed", 100).withParameter("loops", 1);
+    strcpy(line, "Ys\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+
+    mock().expectOneCall("can_replay_start").withParameter("speed", 0x32).withParameter("loops", 0);
+    strcpy(line, "Ys00320000\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+}
+
+TEST(SlcanTestGroup, ReplayControl)
+{
+    mock().expectOneCall("can_replay_clear");
+    mock().expectOneCall("can_replay_set_duration").withParameter("duration", 0x186a0);
+    mock().expectOneCall("can_replay_stop");
+    strcpy(line, "Yc\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    strcpy(line, "Yd000186a0\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    strcpy(line, "Yx\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+}
+
+TEST(SlcanTestGroup, ReplayState)
+{
+    strcpy(line, "Yq\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("1002000050000000a\r", line);
+}
+
+TEST(SlcanTestGroup, GeneratorStartAtLoad)
+{
+    mock().expectOneCall("can_generator_start").withParameter("id_mode", GENERATOR_ID_FIXED).withParameter("id_min", 0x7ff).withParameter("id_max", 0x7ff).withParameter("extended", false).withParameter("dlc_min", 8).withParameter("dlc_max", 8).withParameter("data_mode", GENERATOR_DATA_COUNTER).withParameter("rate", 0).withParameter("load", 80);
+    strcpy(line, "Gl50\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+}
+
+TEST(SlcanTestGroup, GeneratorConfigure)
+{
+    const char* commands[] = {"GR100000001000ffff\r", "Gd08\r", "Gpr\r"};
+    unsigned int i;
+    for (i = 0; i < 3; i++) {
+        strcpy(line, commands[i]);
+        slcan_decode_line(line);
+        STRCMP_EQUAL("\r", line);
+    }
+    mock().expectOneCall("can_generator_start").withParameter("id_mode", GENERATOR_ID_RANDOM).withParameter("id_min", 0x10000000).withParameter("id_max", 0x1000ffff).withParameter("extended", true).withParameter("dlc_min", 0).withParameter("dlc_max", 8).withParameter("data_mode", GENERATOR_DATA_RANDOM).withParameter("rate", 1000).withParameter("load", 0);
+    strcpy(line, "Gh000003e8\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+
+    // back to the defaults
+    const char* defaults[] = {"Gf7ff\r", "Gd88\r", "Gpc\r"};
+    for (i = 0; i < 3; i++) {
+        strcpy(line, defaults[i]);
+        slcan_decode_line(line);
+        STRCMP_EQUAL("\r", line);
+    }
+}
+
+TEST(SlcanTestGroup, GeneratorInvalid)
+{
+    const char* commands[] = {"Gl00\r", "Gl65\r", "Gh00000000\r", "Gd80\r", "Gd09\r", "Gpf0011\r", "Gi123\r"};
+    unsigned int i;
+    for (i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        strcpy(line, commands[i]);
+        slcan_decode_line(line);
+        STRCMP_EQUAL("\a", line);
+    }
+}
+
+TEST(SlcanTestGroup, GeneratorStats)
+{
+    mock().expectOneCall("can_generator_stop");
+    strcpy(line, "Gx\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    strcpy(line, "Gq\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("1000012340384000000020000000300000004\r", line);
+}
+
+TEST(SlcanTestGroup, BenchRun)
+{
+    mock().expectOneCall("can_bench_run").withParameter("duration", 40);
+    strcpy(line, "Br0028\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("00002710000026ac00002710000005a0000a00000070000000b500000120\r", line);
+}
+
+TEST(SlcanTestGroup, BenchInvalid)
+{
+    strcpy(line, "Br0000\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
+    strcpy(line, "Br12\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
+    // longer runs would stall the I/O loop
+    strcpy(line, "Br0029\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
+}
+
+TEST(SlcanTestGroup, LatencyReset)
+{
+    mock().expectOneCall("latency_reset");
+    strcpy(line, "Hr\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    strcpy(line, "Hx\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
+}
+
+TEST(SlcanTestGroup, Stats)
+{
+    mock().expectOneCall("can_stats_reset");
+    mock().expectOneCall("slcan_serial_stats_reset");
+    strcpy(line, "Ir\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    strcpy(line, "Ix\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
+    strcpy(line, "Is\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("00000100000000200000abcd0000000100000003000000040000000500000006001e002001f4\r", line);
+}
+
+TEST(SlcanTestGroup, StatusPeriod)
+{
+    mock().expectOneCall("can_status_set_period").withParameter("period", 1000);
+    strcpy(line, "Ip03e8\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+}
+
+TEST(SlcanTestGroup, CpuLoadReset)
+{
+    mock().expectOneCall("cpu_load_reset");
+    strcpy(line, "Ur\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+}
+
+TEST(SlcanTestGroup, SequenceNumbers)
+{
+    struct can_frame_s frame = {
+        .id = 0x100,
+        .extended = false,
+        .remote = false,
+        .event = false,
+        .timestamp = 0,
+        .length = 1,
+        .data = {0x2a}};
+    struct can_frame_s outage = {
+        .id = CAN_EVENT_HOST_OUTAGE,
+        .extended = false,
+        .remote = false,
+        .event = true,
+        .timestamp = 0,
+        .length = 1,
+        .data = {0x01}};
+    struct can_frame_s overflow = {
+        .id = CAN_EVENT_RX_OVERFLOW,
+        .extended = false,
+        .remote = false,
+        .event = true,
+        .timestamp = 0,
+        .length = 4,
+        .data = {0x00, 0x00, 0x01, 0x02}};
+    char buf[SLCAN_MAX_FRAME_LEN];
+    char expect[SLCAN_MAX_FRAME_LEN];
+
+    slcan_record_to_ascii(buf, &frame);
+    STRCMP_EQUAL("t10012a\r", buf);
+
+    strcpy(line, "Q1\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    size_t len = slcan_record_to_ascii(buf, &frame);
+    CHECK_EQUAL(strlen("t10012a0000\r"), len);
+    CHECK_EQUAL(strlen(buf), len);
+    // numbers continue from the records other tests encoded
+    unsigned int seq = strtoul(&buf[7], NULL, 16);
+    slcan_record_to_ascii(buf, &frame);
+    sprintf(expect, "t10012a%04x\r", (seq + 1) & 0xffff);
+    STRCMP_EQUAL(expect, buf);
+    // the outage record repeats the number of the previous record
+    slcan_record_to_ascii(buf, &outage);
+    sprintf(expect, "E0501%04x\r", (seq + 1) & 0xffff);
+    STRCMP_EQUAL(expect, buf);
+    // the dropped frames used up the numbers before the overflow record
+    slcan_record_to_ascii(buf, &overflow);
+    sprintf(expect, "E0400000102%04x\r", (seq + 2 + 0x102) & 0xffff);
+    STRCMP_EQUAL(expect, buf);
+    slcan_record_to_ascii(buf, &frame);
+    sprintf(expect, "t10012a%04x\r", (seq + 3 + 0x102) & 0xffff);
+    STRCMP_EQUAL(expect, buf);
+
+    strcpy(line, "Q0\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    slcan_record_to_ascii(buf, &frame);
+    STRCMP_EQUAL("t10012a\r", buf);
+
+    strcpy(line, "Q2\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
+}
+
+TEST(SlcanTestGroup, TxCredit)
+{
+    mock().expectOneCall("can_tx_credit_enable").withParameter("enable", true);
+    mock().expectOneCall("can_tx_credit_enable").withParameter("enable", false);
+    strcpy(line, "X1\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    strcpy(line, "X0\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    strcpy(line, "X\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
+}
+
+TEST(SlcanTestGroup, UsbStartOfFrame)
+{
+    mock().expectOneCall("usb_sof_get").andReturnValue(true);
+    mock().expectOneCall("usb_sof_get").andReturnValue(false);
+    strcpy(line, "W\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("W7ff0000001234567890000000012345678a\r", line);
+    strcpy(line, "W\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
+    strcpy(line, "W1\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
+}
+
+TEST(SlcanTestGroup, Trace)
+{
+    mock().expectOneCall("trace_start");
+    mock().expectOneCall("trace_stop");
+    mock().expectOneCall("trace_stop_on_drop").withParameter("enable", true);
+    mock().expectOneCall("trace_stop_on_drop").withParameter("enable", false);
+    strcpy(line, "Js\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    strcpy(line, "Jx\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    strcpy(line, "Jd\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    strcpy(line, "JD\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\r", line);
+    strcpy(line, "Jq\r");
+    slcan_decode_line(line);
+    STRCMP_EQUAL("\a", line);
+}
+
+int main(int ac, char** av)
+{
+    return CommandLineTestRunner::RunAllTests(ac, av);
 }
@@ -130,3 +130,66 @@ TEST(LongTimestamp, DurationNegativeFloatSeconds)
     ltimestamp_t t2 = 100000;
     CHECK_EQUAL(-0.1f, ltimestamp_duration_s(t1, t2));
 }
+
+TEST_GROUP (TimestampExtend) {
+    uint32_t epoch = 0;
+
+    // read as ltimestamp_get() does, storing the epoch when it changes
+    ltimestamp_t read(uint32_t counter)
+    {
+        uint32_t next;
+        ltimestamp_t t = ltimestamp_extend(epoch, counter, &next);
+        epoch = next;
+        return t;
+    }
+};
+
+TEST(TimestampExtend, BeforeFirstWrap)
+{
+    CHECK(1000 == read(1000));
+    CHECK_EQUAL(0, epoch);
+    CHECK(0x80000000ULL == read(0x80000000));
+    CHECK_EQUAL(1, epoch);
+}
+
+TEST(TimestampExtend, Wrap)
+{
+    read(0xfffffff0);
+    CHECK(0x100000005ULL == read(5));
+    CHECK_EQUAL(2, epoch);
+    CHECK(0x100000010ULL == read(0x10));
+}
+
+TEST(TimestampExtend, MultiHourCaptureIsMonotonic)
+{
+    uint64_t t = 0;
+    ltimestamp_t last = 0;
+    while (t < 10ULL * 3600 * 1000000) { // 10 hours, 8 wraps
+        ltimestamp_t now = read(t);
+        CHECK(t == now);
+        CHECK(now >= last);
+        last = now;
+        t += 1234567891; // about 20 minutes
+    }
+}
+
+TEST(TimestampExtend, StaleEpochWrittenBack)
+{
+    read(0xc0000000);
+    uint32_t stale = epoch;
+    read(0x10); // wrapped
+    epoch = stale; // a preempted reader stores the epoch from before the wrap
+    CHECK(0x100000020ULL == read(0x20));
+    CHECK(0x180000000ULL == read(0x80000000));
+}
+
+TEST(TimestampExtend, OldEpochWithinHalfWrap)
+{
+    // the epoch was last stored in the lower half, then the counter wrapped
+    // again within half a wrap of its upper half
+    read(0x70000000);
+    read(0xf0000000);
+    epoch = 0;
+    CHECK(0xf0000010ULL == read(0xf0000010));
+    CHECK(0x100000000ULL == read(0));
+}
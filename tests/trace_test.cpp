@@ -0,0 +1,55 @@
+#include "CppUTest/TestHarness.h"
+#include "../src/trace.h"
+
+TEST_GROUP (Trace) {
+    struct trace_s t;
+
+    void setup()
+    {
+        trace_init(&t);
+    }
+};
+
+TEST(Trace, Empty)
+{
+    CHECK_EQUAL(0, trace_count(&t));
+    POINTERS_EQUAL(NULL, trace_get(&t, 0));
+}
+
+TEST(Trace, RecordSize)
+{
+    CHECK_EQUAL(8, sizeof(struct trace_record_s));
+    CHECK_EQUAL(12, sizeof(struct trace_dump_header_s));
+    CHECK_EQUAL(16, sizeof(struct trace_dump_thread_s));
+}
+
+TEST(Trace, Add)
+{
+    trace_add(&t, 100, TRACE_CAN_RX, 0x123);
+    trace_add(&t, 200, TRACE_RX_POST, 1);
+    CHECK_EQUAL(2, trace_count(&t));
+    const struct trace_record_s* r = trace_get(&t, 0);
+    CHECK_EQUAL(100, r->time);
+    CHECK_EQUAL(TRACE_CAN_RX, r->event);
+    CHECK_EQUAL(0x123, r->arg);
+    CHECK_EQUAL(200, trace_get(&t, 1)->time);
+    POINTERS_EQUAL(NULL, trace_get(&t, 2));
+}
+
+TEST(Trace, WrapKeepsMostRecent)
+{
+    unsigned int i;
+    for (i = 0; i < TRACE_SIZE + 10; i++) {
+        trace_add(&t, i, TRACE_LINE, i);
+    }
+    CHECK_EQUAL(TRACE_SIZE, trace_count(&t));
+    CHECK_EQUAL(10, trace_get(&t, 0)->time);
+    CHECK_EQUAL(TRACE_SIZE + 9, trace_get(&t, TRACE_SIZE - 1)->time);
+}
+
+TEST(Trace, Disabled)
+{
+    t.enabled = false;
+    trace_add(&t, 100, TRACE_CAN_RX, 0x123);
+    CHECK_EQUAL(0, trace_count(&t));
+}
@@ -0,0 +1,103 @@
+#include "CppUTest/TestHarness.h"
+#include "../src/tx_mailbox.h"
+
+static unsigned int host_done;
+static unsigned int generator_done;
+static unsigned int generator_failed;
+static uint32_t last_tag;
+static ltimestamp_t last_sof;
+
+static void host_tx_done(uint32_t tag, ltimestamp_t sof, bool ok)
+{
+    (void)ok;
+    host_done++;
+    last_tag = tag;
+    last_sof = sof;
+}
+
+static void generator_tx_done(uint32_t tag, ltimestamp_t sof, bool ok)
+{
+    (void)tag;
+    (void)sof;
+    generator_done++;
+    if (!ok) {
+        generator_failed++;
+    }
+}
+
+TEST_GROUP (TxMailbox) {
+    struct tx_mailbox_s m;
+    ltimestamp_t sof[TX_MAILBOX_COUNT];
+
+    void setup()
+    {
+        tx_mailbox_init(&m);
+        host_done = 0;
+        generator_done = 0;
+        generator_failed = 0;
+        sof[0] = 100;
+        sof[1] = 200;
+        sof[2] = 300;
+    }
+};
+
+TEST(TxMailbox, PicksFirstEmptyAccountedMailbox)
+{
+    CHECK_EQUAL(1, tx_mailbox_pick(&m, 0x7));
+    tx_mailbox_load(&m, 1, NULL, 0);
+    // empty again but not accounted yet
+    CHECK_EQUAL(2, tx_mailbox_pick(&m, 0x7));
+    CHECK_EQUAL(0, tx_mailbox_pick(&m, 0x1));
+    CHECK_EQUAL(0, tx_mailbox_pick(&m, 0x0));
+}
+
+TEST(TxMailbox, CompletionCallsDoneOnce)
+{
+    tx_mailbox_load(&m, 2, host_tx_done, 42);
+    CHECK_EQUAL(0x2, tx_mailbox_complete(&m, 0x2, sof));
+    CHECK_EQUAL(1, host_done);
+    CHECK_EQUAL(42, last_tag);
+    CHECK_EQUAL(200, last_sof);
+    CHECK_EQUAL(0, tx_mailbox_complete(&m, 0x2, sof));
+    CHECK_EQUAL(1, host_done);
+    CHECK_EQUAL(2, tx_mailbox_pick(&m, 0x2));
+}
+
+TEST(TxMailbox, ErrorHalfCompletesToo)
+{
+    tx_mailbox_load(&m, 1, generator_tx_done, 0);
+    CHECK_EQUAL(0x1, tx_mailbox_complete(&m, 0x1 << 16, sof));
+    CHECK_EQUAL(1, generator_done);
+    CHECK_EQUAL(1, generator_failed);
+}
+
+TEST(TxMailbox, CancelledLoadIsNotCompleted)
+{
+    tx_mailbox_load(&m, 1, host_tx_done, 0);
+    tx_mailbox_cancel(&m, 1);
+    CHECK_EQUAL(0, tx_mailbox_complete(&m, 0x1, sof));
+    CHECK_EQUAL(0, host_done);
+}
+
+TEST(TxMailbox, GeneratorTrafficAlongsideHost)
+{
+    unsigned int host_sent = 0;
+    unsigned int i;
+    for (i = 0; i < 30; i++) {
+        // the generator takes a mailbox whenever one is free
+        unsigned int mailbox = tx_mailbox_pick(&m, 0x7);
+        if (mailbox != 0) {
+            tx_mailbox_load(&m, mailbox, generator_tx_done, i);
+        }
+        mailbox = tx_mailbox_pick(&m, 0x7);
+        if (i % 3 == 0 && mailbox != 0) {
+            tx_mailbox_load(&m, mailbox, host_tx_done, i);
+            host_sent++;
+        }
+        // all mailboxes complete, some with lost arbitration
+        tx_mailbox_complete(&m, i % 2 ? 0x7 : (0x3 | (0x4 << 16)), sof);
+    }
+    CHECK(host_sent > 0);
+    CHECK_EQUAL(host_sent, host_done);
+    CHECK_EQUAL(30, generator_done);
+}
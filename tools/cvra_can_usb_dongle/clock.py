@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+"""
+Maps the dongle's microsecond clock to the host clock.
+
+Each exchange bounds the host time of the dongle's reply between the send
+and the receive time. The lines host = a + b * device that pass through all
+these intervals form a convex set, bounded by the upper envelope of the
+send times and the lower envelope of the receive times (the shortest round
+trips). The mapping is taken from this set and its bound is the largest
+distance to any other line of the set over the exchanges, a hard bound as
+long as the drift is constant.
+
+The dongle also latches its clock at every USB start of frame (`W`
+command). The frames run on the host controller's crystal, which can be
+tens of ppm away from the host clock, so the drift they give is only used
+when it lies in the set and tightens the bound. User space can't read the
+host's frame counter (usbfs and libusb have no call for it), so the frames
+can't anchor the offset.
+"""
+
+import argparse
+import json
+import time
+import serial
+
+FRAME_US = 1000
+FRAME_WRAP = 2048
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("port", help="Serial port to which the dongle is connected.")
+    parser.add_argument("--samples", type=int, default=500,
+                        help="Number of exchanges (default: %(default)s).")
+    parser.add_argument("--interval", type=float, default=0.02,
+                        help="Time between exchanges in seconds (default: %(default)s).")
+    parser.add_argument("--output", "-o", metavar="FILE",
+                        help="Write the mapping to a JSON file.")
+
+    return parser.parse_args()
+
+
+def read_line(conn):
+    data = bytes()
+    while not data.endswith(b"\r") and not data.endswith(b"\a"):
+        c = conn.read(1)
+        if not c:
+            raise RuntimeError("No response from the dongle")
+        data += c
+    return data
+
+
+def exchange(conn):
+    """
+    Returns (host send time [s], host receive time [s], frame number,
+    start of frame time [us], reply time [us]).
+    """
+    t0 = time.time()
+    conn.write(b"W\r")
+    # received frames and events streamed meanwhile are skipped
+    line = read_line(conn)
+    while not line.startswith(b"W"):
+        if line.endswith(b"\a"):
+            raise RuntimeError("W refused")
+        line = read_line(conn)
+    t1 = time.time()
+    if len(line) != 37:
+        raise RuntimeError("Unexpected response {!r}".format(line))
+    return (t0, t1, int(line[1:4], 16), int(line[4:20], 16), int(line[20:36], 16))
+
+
+def unwrap_frames(samples):
+    """
+    Frame numbers since the first sample, the 11 bit numbers wrap every
+    2.048 s and are unwrapped with the dongle clock.
+    """
+    first = samples[0]
+    frames = []
+    for s in samples:
+        elapsed = round((s[3] - first[3]) / FRAME_US)
+        delta = (s[2] - first[2] - elapsed) % FRAME_WRAP
+        if delta > FRAME_WRAP // 2:
+            delta -= FRAME_WRAP
+        frames.append(elapsed + delta)
+    return frames
+
+
+def fit_line(x, y):
+    """ Least squares fit of y = a + b * x, returns (a, b). """
+    n = len(x)
+    mx = sum(x) / n
+    my = sum(y) / n
+    sxx = sum((v - mx) ** 2 for v in x)
+    sxy = sum((u - mx) * (v - my) for u, v in zip(x, y))
+    b = sxy / sxx
+    return my - b * mx, b
+
+
+def upper_hull(points):
+    """ Upper convex hull of (x, y) points sorted by x. """
+    hull = []
+    for p in points:
+        while len(hull) >= 2 and ((hull[-1][0] - hull[-2][0]) * (p[1] - hull[-2][1])
+                                  - (hull[-1][1] - hull[-2][1]) * (p[0] - hull[-2][0])) >= 0:
+            hull.pop()
+        hull.append(p)
+    return hull
+
+
+def feasible_lines(lower, upper, eps=1e-9):
+    """
+    Vertices (a, b) of the set of lines y = a + b * x above the lower and
+    below the upper points.
+    """
+    lower = upper_hull(sorted(lower))
+    upper = [(x, -y) for x, y in upper_hull(sorted((x, -y) for x, y in upper))]
+    constraints = lower + upper
+    vertices = []
+    for i, (xi, yi) in enumerate(constraints):
+        for xj, yj in constraints[i + 1:]:
+            if xi == xj:
+                continue
+            b = (yi - yj) / (xi - xj)
+            a = yi - b * xi
+            if all(a + b * x >= y - eps for x, y in lower) and \
+               all(a + b * x <= y + eps for x, y in upper):
+                vertices.append((a, b))
+    return vertices
+
+
+def line_bound(line, vertices, xs):
+    """ Largest distance between line and the vertices over the xs [s]. """
+    a, b = line
+    return max(abs(va - a + (vb - b) * x) for va, vb in vertices for x in xs)
+
+
+def fit(samples):
+    """
+    Returns the mapping host = offset + scale * (device - reference), in
+    seconds and microseconds, with the drift in ppm and the bound of the
+    mapping over the exchanges.
+    """
+    reference = samples[0][4]
+    host_reference = samples[0][0]
+    # device [s] against the send and receive host times [s]
+    xs = [(s[4] - reference) * 1e-6 for s in samples]
+    lower = [(x, s[0] - host_reference) for x, s in zip(xs, samples)]
+    upper = [(x, s[1] - host_reference) for x, s in zip(xs, samples)]
+    vertices = feasible_lines(lower, upper)
+    if not vertices:
+        raise RuntimeError("Inconsistent exchanges, the host clock stepped")
+    span = (min(xs), max(xs))
+
+    centre = (sum(v[0] for v in vertices) / len(vertices),
+              sum(v[1] for v in vertices) / len(vertices))
+    candidates = [centre]
+
+    # the start of frame drift, if the frame clock ran at the host's rate
+    frames = unwrap_frames(samples)
+    _, us_per_frame = fit_line(frames, [s[3] for s in samples])
+    b = FRAME_US / us_per_frame
+    lo = max(y - b * x for x, y in lower)
+    hi = min(y - b * x for x, y in upper)
+    if lo <= hi:
+        candidates.append(((lo + hi) / 2, b))
+
+    a, b = min(candidates, key=lambda l: line_bound(l, vertices, span))
+    rtts = [s[1] - s[0] for s in samples]
+    return {
+        'reference': reference,
+        'offset': host_reference + a,
+        'scale': b * 1e-6,
+        'drift_ppm': (1 / b - 1) * 1e6,
+        'bound_s': line_bound((a, b), vertices, span),
+        'min_rtt_s': min(rtts),
+    }
+
+
+def main():
+    args = parse_args()
+
+    conn = serial.Serial(args.port, 115200, timeout=1)
+    samples = []
+    for _ in range(args.samples):
+        samples.append(exchange(conn))
+        time.sleep(args.interval)
+
+    result = fit(samples)
+    print("host = {offset:.6f} + {scale:.12e} * (device_us - {reference})".format(**result))
+    print("dongle clock drift {:+.2f} ppm against the host clock".format(result['drift_ppm']))
+    print("mapping within +/- {:.0f} us over the exchanges, shortest round trip {:.0f} us".format(
+        result['bound_s'] * 1e6, result['min_rtt_s'] * 1e6))
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(result, f, indent=2)
+
+if __name__ == '__main__':
+    main()
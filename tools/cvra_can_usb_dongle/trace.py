@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""
+Reads the binary event trace of the dongle and converts it to the Chrome
+trace event format, which can be opened in Perfetto or chrome://tracing.
+"""
+
+import argparse
+import json
+import struct
+import serial
+
+HEADER = struct.Struct('<IIHBB')
+THREAD = struct.Struct('<H14s')
+RECORD = struct.Struct('<IBBH')
+MAGIC = 0x4352544a
+
+EVENTS = {
+    1: 'switch',
+    2: 'irq',
+    3: 'can_rx',
+    4: 'rx_post',
+    5: 'rx_drop',
+    6: 'rx_fetch',
+    7: 'encode',
+    8: 'usb_write',
+    9: 'usb_write_done',
+    10: 'line',
+    11: 'can_tx',
+    12: 'can_tx_fail',
+}
+
+SWITCH = 1
+IRQ = 2
+USB_WRITE = 8
+USB_WRITE_DONE = 9
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("input",
+                        help="Serial port to which the dongle is connected, or "
+                        "a binary dump when --file is given.")
+    parser.add_argument("output", help="JSON trace file to write.")
+    parser.add_argument("--file", action="store_true",
+                        help="Read a binary dump saved with --save instead of the dongle.")
+    parser.add_argument("--save", metavar="FILE",
+                        help="Also save the binary dump read from the dongle.")
+
+    return parser.parse_args()
+
+
+def read_line(conn):
+    data = bytes()
+    while not data.endswith(b"\r") and not data.endswith(b"\a"):
+        c = conn.read(1)
+        if not c:
+            raise RuntimeError("No response from the dongle")
+        data += c
+    return data
+
+
+def read_dump(port):
+    conn = serial.Serial(port, 115200, timeout=1)
+    conn.write(b"Jb\r")
+    # frames and events received before the dump are skipped
+    header = read_line(conn)
+    while not header.startswith(b"J"):
+        if header.endswith(b"\a"):
+            raise RuntimeError("Trace dump refused")
+        header = read_line(conn)
+    size = int(header[1:-1], 16)
+    data = conn.read(size)
+    if len(data) != size or read_line(conn) != b"\r":
+        raise RuntimeError("Incomplete trace dump")
+    return data
+
+
+def decode(data):
+    magic, clock, count, nthreads, _ = HEADER.unpack_from(data, 0)
+    if magic != MAGIC:
+        raise RuntimeError("Not a trace dump")
+    offset = HEADER.size
+
+    threads = {}
+    for _ in range(nthreads):
+        tid, name = THREAD.unpack_from(data, offset)
+        threads[tid] = name.split(b"\0")[0].decode(errors="replace")
+        offset += THREAD.size
+
+    # the cycle counter wraps every 2^32 cycles
+    records = []
+    wraps = 0
+    last = None
+    for _ in range(count):
+        time, event, _, arg = RECORD.unpack_from(data, offset)
+        offset += RECORD.size
+        if last is not None and time < last:
+            wraps += 1
+        last = time
+        records.append(((time + (wraps << 32)) * 1e6 / clock, event, arg))
+
+    return threads, records
+
+
+def convert(threads, records):
+    trace = []
+    for tid, name in threads.items():
+        trace.append({'ph': 'M', 'name': 'thread_name', 'pid': 0, 'tid': tid,
+                      'args': {'name': name}})
+    trace.append({'ph': 'M', 'name': 'thread_name', 'pid': 0, 'tid': 0,
+                  'args': {'name': 'interrupts'}})
+
+    current = None
+    for ts, event, arg in records:
+        name = EVENTS.get(event, 'event{}'.format(event))
+        if event == SWITCH:
+            # one slice per thread activation
+            if current is not None:
+                trace.append({'ph': 'E', 'pid': 0, 'tid': current, 'ts': ts})
+            current = arg
+            trace.append({'ph': 'B', 'name': threads.get(arg, hex(arg)),
+                          'pid': 0, 'tid': current, 'ts': ts})
+        elif event == IRQ:
+            trace.append({'ph': 'i', 'name': 'irq{}'.format(arg), 's': 't',
+                          'pid': 0, 'tid': 0, 'ts': ts})
+        elif event in (USB_WRITE, USB_WRITE_DONE) and current is not None:
+            trace.append({'ph': 'B' if event == USB_WRITE else 'E',
+                          'name': 'usb_write', 'pid': 0, 'tid': current,
+                          'ts': ts, 'args': {'bytes': arg}})
+        else:
+            trace.append({'ph': 'i', 'name': name, 's': 't', 'pid': 0,
+                          'tid': current if current is not None else 0,
+                          'ts': ts, 'args': {'arg': arg}})
+    if current is not None and records:
+        trace.append({'ph': 'E', 'pid': 0, 'tid': current, 'ts': records[-1][0]})
+
+    return {'traceEvents': trace, 'displayTimeUnit': 'ns'}
+
+
+def main():
+    args = parse_args()
+
+    if args.file:
+        with open(args.input, 'rb') as f:
+            data = f.read()
+    else:
+        data = read_dump(args.input)
+        if args.save:
+            with open(args.save, 'wb') as f:
+                f.write(data)
+
+    threads, records = decode(data)
+
+    with open(args.output, 'w') as f:
+        json.dump(convert(threads, records), f)
+
+if __name__ == '__main__':
+    main()
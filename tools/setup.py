@@ -24,6 +24,8 @@ setup(
     entry_points={
         'console_scripts': [
             'can_dongle_power=cvra_can_usb_dongle.power:main',
+            'can_dongle_trace=cvra_can_usb_dongle.trace:main',
+            'can_dongle_clock=cvra_can_usb_dongle.clock:main',
             ],
         },
     )
@@ -0,0 +1,59 @@
+import random
+import sys
+import types
+import unittest
+
+sys.modules.setdefault('serial', types.ModuleType('serial'))
+from cvra_can_usb_dongle import clock
+
+
+def simulate(device_ppm, frame_ppm, count=500, interval=0.02, seed=1):
+    """ Exchanges against a dongle and a frame clock off the host clock. """
+    rng = random.Random(seed)
+    frame_period = 1e-3 * (1 - frame_ppm * 1e-6)
+
+    def device_us(t):
+        return int(5000000 + (t - 100) * 1e6 * (1 + device_ppm * 1e-6))
+
+    samples, replies = [], []
+    t = 100.0
+    for _ in range(count):
+        t0 = t
+        t1 = t0 + 0.001 + rng.random() * 0.002
+        reply = t0 + rng.random() * (t1 - t0)
+        frame = int((reply - 99.5) / frame_period)
+        sof = device_us(99.5 + frame * frame_period)
+        samples.append((t0, t1, frame % clock.FRAME_WRAP, sof, device_us(reply)))
+        replies.append(reply)
+        t += interval
+    return samples, replies
+
+
+def host_time(result, device_us):
+    return result['offset'] + result['scale'] * (device_us - result['reference'])
+
+
+class ClockFitTest(unittest.TestCase):
+    def check(self, device_ppm, frame_ppm):
+        samples, replies = simulate(device_ppm, frame_ppm)
+        result = clock.fit(samples)
+        for s, reply in zip(samples, replies):
+            self.assertLessEqual(abs(host_time(result, s[4]) - reply), result['bound_s'] + 1e-9)
+        self.assertLess(result['bound_s'], 1e-3)
+        self.assertAlmostEqual(result['drift_ppm'], device_ppm, delta=5)
+
+    def test_frame_clock_at_host_rate(self):
+        self.check(20, 0)
+
+    def test_skewed_frame_clock(self):
+        self.check(20, -50)
+
+    def test_stepped_host_clock_raises(self):
+        samples, _ = simulate(0, 0)
+        samples[-1] = (samples[-1][0] + 1, samples[-1][1] + 1) + samples[-1][2:]
+        with self.assertRaises(RuntimeError):
+            clock.fit(samples)
+
+
+if __name__ == '__main__':
+    unittest.main()